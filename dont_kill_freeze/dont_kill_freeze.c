@@ -91,10 +91,13 @@ static void do_send_sig_info_before(hook_fargs4_t* args, void* udata) {
 #endif /* CONFIG_DEBUG_CMDLINE */
   if (sig != SIGKILL || siginfo->si_code != 0)
     return;
-  if (task_uid(current).val < MIN_SYSTEM_UID || task_uid(current).val > MAX_SYSTEM_UID)
+  uid_t src_uid = task_uid(current).val;
+  if (src_uid < MIN_SYSTEM_UID || src_uid > MAX_SYSTEM_UID)
     return;
-  if (task_uid(dst).val == last_uid
-    || task_uid(dst).val < MIN_USERAPP_UID
+  // 只有 system 发送的 SIGKILL 才读取目标的 cred
+  uid_t dst_uid = task_uid(dst).val;
+  if (dst_uid == last_uid
+    || dst_uid < MIN_USERAPP_UID
     || get_oom_score_adj(dst) > oom_score_adj_max)
     return;
 
@@ -108,7 +111,7 @@ static void do_send_sig_info_before(hook_fargs4_t* args, void* udata) {
     logkm("skip\n");
 #endif /* CONFIG_DEBUG */
   } else {
-    last_uid = task_uid(dst).val;
+    last_uid = dst_uid;
   }
 }
 
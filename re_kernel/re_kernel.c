@@ -38,6 +38,45 @@ KPM_DESCRIPTION("Re:Kernel, support 4.4 ~ 6.6");
 #define MAX_SYSTEM_UID 2000
 #define PARCEL_OFFSET 16
 #define INTERFACETOKEN_BUFF_SIZE 140
+// 需要读取的 Parcel 数据: 头部 + UTF-16 interface token
+#define INTERFACETOKEN_DATA_SIZE (PARCEL_OFFSET + 4 + INTERFACETOKEN_BUFF_SIZE * 2)
+// 从 binder_buffer 分段读取, 栈上只保留头部和一段 UTF-16
+#define INTERFACETOKEN_HEAD_SIZE (PARCEL_OFFSET + 4)
+#define INTERFACETOKEN_CHUNK 64
+// Android 11+ Parcel 头部的 kHeader
+#define PARCEL_HEADER_SYST 0x53595354
+#define PARCEL_HEADER_VNDR 0x564e4452
+#define PARCEL_HEADER_RECO 0x5245434f
+#define PARCEL_STRING_MAX 1024
+#define REKERNEL_RING_SIZE 128
+#define REKERNEL_FLUSH_INTERVAL 1000
+#define REKERNEL_CONGESTED_INTERVAL 10
+#define REKERNEL_COALESCE_SIZE 32
+#define REKERNEL_THAW_SIZE 256
+#define REKERNEL_LATENCY_BUCKETS 22
+#define REKERNEL_ACK_SIZE 256
+// 每次最多释放的消息数, 数组在 binder 调用栈上
+#define BINDER_RECLAIM_BATCH 16
+#define BINDER_RECLAIM_KEEP_MAX 64
+#define ASYNC_INDEX_NODES 32
+#define ASYNC_INDEX_ENTRIES 4096
+#define ASYNC_INDEX_BUCKETS 1024
+#define ASYNC_INDEX_NIL (-1)
+#define RPC_NAME_CACHE_SETS 64
+#define RPC_NAME_CACHE_WAYS 4
+#define FROZEN_PID_MAX 65536
+#define FROZEN_UID_BUCKETS 4096
+#define FROZEN_LONG_BITS (sizeof(unsigned long) * 8)
+#define ASYNC_PRESSURE_SIZE 64
+#define ASYNC_PRESSURE_PROBE 4
+#define ASYNC_PRESSURE_STALE_NS (60 * 1000000000ULL)
+#define RECLAIM_STATS_SLOTS 32
+#define NETWORK_WINDOW_SIZE 64
+#define NETWORK_WINDOW_PROBE 4
+#define SOCK_UID_CACHE_SIZE 256
+#define BINDER_SWEEP_NODES 64
+#define BINDER_SWEEP_GROUPS 16
+#define REKERNEL_HOOK_SLOTS 16
 
 enum report_type {
   BINDER,
@@ -50,11 +89,13 @@ enum binder_type {
   REPLY,
   TRANSACTION,
   OVERFLOW,
+  BUDGET,
 };
 static const char* binder_type[] = {
     "reply",
     "transaction",
     "free_buffer_full",
+    "async_budget",
 };
 
 #define IZERO (1UL << 0x10)
@@ -62,11 +103,20 @@ static const char* binder_type[] = {
 
 // cgroup_freezing, cgroupv1_freeze
 static bool (*cgroup_freezing)(struct task_struct* task);
+// 冻结状态变化, 用于维护 frozen_map
+static bool (*freeze_task)(struct task_struct* p);
+static void (*__thaw_task)(struct task_struct* p);
+static void (*cgroup_freeze_task)(struct task_struct* task, bool freeze);
+// 进程退出后清除 frozen_map, 可能被内联
+static void (*release_task)(struct task_struct* p);
 // send_netlink_message
 struct sk_buff* kfunc_def(__alloc_skb)(unsigned int size, gfp_t gfp_mask, int flags, int node);
 struct nlmsghdr* kfunc_def(__nlmsg_put)(struct sk_buff* skb, u32 portid, u32 seq, int type, int len, int flags);
 void kfunc_def(kfree_skb)(struct sk_buff* skb);
 int kfunc_def(netlink_unicast)(struct sock* ssk, struct sk_buff* skb, u32 portid, int nonblock);
+int kfunc_def(netlink_broadcast)(struct sock* ssk, struct sk_buff* skb, u32 portid, u32 group, gfp_t allocation);
+int kfunc_def(netlink_has_listeners)(struct sock* sk, unsigned int group);
+bool kfunc_def(netlink_capable)(const struct sk_buff* skb, int cap);
 // netlink_rcv
 int kfunc_def(netlink_rcv_skb)(struct sk_buff* skb,
                                int (*cb)(struct sk_buff*, struct nlmsghdr*, struct netlink_ext_ack*));
@@ -80,6 +130,16 @@ struct proc_dir_entry* kfunc_def(proc_mkdir)(const char* name, struct proc_dir_e
 struct proc_dir_entry* kfunc_def(proc_create_data)(const char* name, umode_t mode, struct proc_dir_entry* parent,
                                                    const struct file_operations* proc_fops, void* data);
 void kfunc_def(proc_remove)(struct proc_dir_entry* de);
+// /proc/rekernel/events
+void* kfunc_def(vmalloc_user)(unsigned long size);
+int kfunc_def(remap_vmalloc_range)(struct vm_area_struct* vma, void* addr, unsigned long pgoff);
+void kfunc_def(__init_waitqueue_head)(struct wait_queue_head* wq_head, const char* name, void* key);
+void kfunc_def(__wake_up)(struct wait_queue_head* wq_head, unsigned int mode, int nr, void* key);
+// /proc/rekernel/latency
+ssize_t kfunc_def(simple_read_from_buffer)(void __user* to, size_t count, loff_t* ppos, const void* from,
+                                           size_t available);
+// 5.10 加入, 用于判断 proc_ops 布局
+ssize_t kfunc_def(seq_read_iter)(struct kiocb* iocb, struct iov_iter* iter);
 // hook binder_proc_transaction
 static int (*binder_proc_transaction)(struct binder_transaction* t, struct binder_proc* proc,
                                       struct binder_thread* thread);
@@ -95,8 +155,24 @@ static void (*binder_transaction_buffer_release_v4)(struct binder_proc* proc, st
 static void (*binder_transaction_buffer_release_v3)(struct binder_proc* proc, struct binder_buffer* buffer,
                                                     binder_size_t* failed_at);
 static void (*binder_alloc_free_buf)(struct binder_alloc* alloc, struct binder_buffer* buffer);
+// 从目标进程的 binder_buffer 读取 rpc_name, 找不到时 hook binder_transaction 从发送者复制
+static int (*binder_alloc_copy_from_buffer)(struct binder_alloc* alloc, void* dest, struct binder_buffer* buffer,
+                                            binder_size_t buffer_offset, size_t bytes);
 void kfunc_def(kfree)(const void* objp);
 struct binder_stats kvar_def(binder_stats);
+// 存在时 binder 支持 TF_UPDATE_TXN, 可能被内联
+static struct binder_transaction* (*binder_find_outdated_transaction_ilocked)(struct binder_transaction* t,
+                                                                              struct list_head* target_list);
+// binder_node 释放时使 rpc_name 缓存失效, 可能被内联
+static void (*binder_free_node)(struct binder_node* node);
+// binder_sweep_frozen, 进程冻结后清理 async_todo
+struct hlist_head kvar_def(binder_procs);
+struct mutex kvar_def(binder_procs_lock);
+void kfunc_def(mutex_lock)(struct mutex* lock);
+void kfunc_def(mutex_unlock)(struct mutex* lock);
+struct rb_node* kfunc_def(rb_first)(const struct rb_root* root);
+struct rb_node* kfunc_def(rb_next)(const struct rb_node* node);
+static void (*binder_dec_node_tmpref)(struct binder_node* node);
 // hook do_send_sig_info
 static int (*do_send_sig_info)(int sig, struct siginfo* info, struct task_struct* p, enum pid_type type);
 // hook binder_transaction
@@ -113,8 +189,33 @@ kuid_t kfunc_def(sock_i_uid)(struct sock* sk);
 static int (*tcp_v4_rcv)(struct sk_buff* skb);
 static int (*tcp_v6_rcv)(struct sk_buff* skb);
 static int ipv4_version = 4, ipv6_version = 6;
+// hook udp 和 quic, ipv4 和 ipv6 共用, 进入 sock 接收队列前 sk 已确定
+static int (*__udp_enqueue_schedule_skb)(struct sock* sk, struct sk_buff* skb);
 #endif /* CONFIG_NETWORK */
 
+// rekernel_queue_event
+static int kvar_def(cpu_number);
+static unsigned int kvar_def(nr_cpu_ids);
+static int kvar_def(pid_max);
+static struct task_struct kvar_def(init_task);
+void kfunc_def(complete)(struct completion* x);
+void* kfunc_def(vzalloc)(unsigned long size);
+void kfunc_def(vfree)(const void* addr);
+void kfunc_def(synchronize_rcu)(void);
+void kfunc_def(msleep)(unsigned int msecs);
+void kfunc_def(__rcu_read_lock)(void);
+void kfunc_def(__rcu_read_unlock)(void);
+// rekernel_flush_thread
+struct task_struct* kfunc_def(kthread_create_on_node)(int (*threadfn)(void* data), void* data, int node,
+                                                      const char namefmt[], ...);
+int kfunc_def(wake_up_process)(struct task_struct* p);
+int kfunc_def(kthread_stop)(struct task_struct* k);
+bool kfunc_def(kthread_should_stop)(void);
+long kfunc_def(wait_for_completion_interruptible_timeout)(struct completion* x, unsigned long timeout);
+unsigned long kfunc_def(__msecs_to_jiffies)(const unsigned int m);
+u64 kfunc_def(ktime_get_mono_fast_ns)(void);
+struct task_struct* kfunc_def(find_task_by_vpid)(pid_t nr);
+
 // _raw_spin_lock && _raw_spin_unlock
 void kfunc_def(_raw_spin_lock)(raw_spinlock_t* lock);
 void kfunc_def(_raw_spin_unlock)(raw_spinlock_t* lock);
@@ -141,6 +242,53 @@ struct struct_offset struct_offset = {};
 #endif
 #include "re_offsets.c"
 
+// 任务身份快照, 每个事件只读取一次 cred
+struct rekernel_task {
+  struct task_struct* task;
+  pid_t pid;
+  pid_t tgid;
+  uid_t uid;
+  const char* comm;
+};
+static inline void rekernel_task_snapshot(struct rekernel_task* snap, struct task_struct* task) {
+  snap->task = task;
+  snap->pid = task_pid_nr(task);
+  snap->tgid = task_tgid_nr(task);
+  snap->uid = task_uid(task).val;
+  snap->comm = get_task_comm(task);
+}
+
+// 正在执行的 hook 数, 按 cpu 分散计数, 退出时减少进入时的计数, 卸载时等待所有计数归零后再释放内存
+// inline hook 不处于 rcu 读临界区, synchronize_rcu 无法保证 hook 已经结束
+struct rekernel_hook_slot {
+  long users;
+} __aligned(64);
+static struct rekernel_hook_slot rekernel_hook_slots[REKERNEL_HOOK_SLOTS];
+static bool rekernel_unloading;
+
+// 卸载开始后返回 NULL, hook 直接返回
+static inline struct rekernel_hook_slot* rekernel_hook_enter(void) {
+  int cpu = *(int*)((uintptr_t)kvar(cpu_number) + rekernel_cpu_offset());
+  struct rekernel_hook_slot* slot = &rekernel_hook_slots[cpu & (REKERNEL_HOOK_SLOTS - 1)];
+  __atomic_fetch_add(&slot->users, 1, __ATOMIC_SEQ_CST);
+  if (unlikely(__atomic_load_n(&rekernel_unloading, __ATOMIC_SEQ_CST))) {
+    __atomic_fetch_sub(&slot->users, 1, __ATOMIC_RELEASE);
+    return NULL;
+  }
+  return slot;
+}
+static inline void rekernel_hook_exit(struct rekernel_hook_slot* slot) {
+  __atomic_fetch_sub(&slot->users, 1, __ATOMIC_RELEASE);
+}
+// 设置 rekernel_unloading 并移除 hook 后调用
+static void rekernel_hook_drain(void) {
+  for (int i = 0; i < REKERNEL_HOOK_SLOTS; i++) {
+    while (__atomic_load_n(&rekernel_hook_slots[i].users, __ATOMIC_SEQ_CST)) {
+      msleep(1);
+    }
+  }
+}
+
 // binder_node_lock
 static inline void binder_node_lock(struct binder_node* node) {
   spinlock_t* node_lock = binder_node_lock_ptr(node);
@@ -176,20 +324,222 @@ static inline bool jobctl_frozen(struct task_struct* task) {
   unsigned long jobctl = task_jobctl(task);
   return ((jobctl & JOBCTL_TRAP_FREEZE) != 0);
 }
+
+// 按 tgid 记录冻结的进程, 按 uid 哈希统计冻结进程数, 只在冻结状态变化时更新
+struct frozen_map {
+  u32 nr;
+  unsigned long tgids[FROZEN_PID_MAX / FROZEN_LONG_BITS];
+  // 新冻结等待清理 async_todo 的进程, sweeping 只由 flush 线程访问
+  unsigned long sweep[FROZEN_PID_MAX / FROZEN_LONG_BITS];
+  unsigned long sweeping[FROZEN_PID_MAX / FROZEN_LONG_BITS];
+  u16 tgid_bucket[FROZEN_PID_MAX];
+  u16 uids[FROZEN_UID_BUCKETS];
+};
+static struct frozen_map* frozen_map;
+// 初始扫描完成前, 或缺少 cgroup_freeze_task 的 hook, 或 pid 可能超出位图时, 位图不可信
+static bool frozen_map_ready;
+static spinlock_t frozen_map_lock;
+// 缺少所需的符号或偏移时不清理
+static bool binder_sweep_supported;
+static bool binder_sweep_pending;
+
+static inline u16 frozen_uid_bucket(uid_t uid) { return (uid ^ (uid >> 12)) & (FROZEN_UID_BUCKETS - 1); }
+
+static inline bool frozen_tgid_test(pid_t tgid) {
+  unsigned long word = __atomic_load_n(&frozen_map->tgids[tgid / FROZEN_LONG_BITS], __ATOMIC_RELAXED);
+  return (word & (1UL << (tgid % FROZEN_LONG_BITS))) != 0;
+}
+
+// 返回 true 表示进程刚进入冻结状态
+static bool frozen_map_set(struct task_struct* task, bool frozen) {
+  pid_t tgid = task_tgid_nr(task);
+  if (!frozen_map || tgid <= 0)
+    return false;
+  if (tgid >= FROZEN_PID_MAX) {
+    // pid_max 运行时被调大, 位图不再完整
+    if (frozen)
+      __atomic_store_n(&frozen_map_ready, false, __ATOMIC_RELEASE);
+    return false;
+  }
+  unsigned long* word = &frozen_map->tgids[tgid / FROZEN_LONG_BITS];
+  unsigned long mask = 1UL << (tgid % FROZEN_LONG_BITS);
+
+  unsigned long flags = rekernel_irq_save();
+  spin_lock(&frozen_map_lock);
+  bool old = (*word & mask) != 0;
+  if (frozen && old) {
+    // release_task 被内联时旧进程的位可能残留, uid 不同时说明 tgid 已被复用
+    u16 bucket = frozen_uid_bucket(task_uid(task).val);
+    if (frozen_map->tgid_bucket[tgid] != bucket) {
+      frozen_map->uids[frozen_map->tgid_bucket[tgid]]--;
+      frozen_map->tgid_bucket[tgid] = bucket;
+      frozen_map->uids[bucket]++;
+      old = false;
+    }
+  } else if (frozen && !old) {
+    u16 bucket = frozen_uid_bucket(task_uid(task).val);
+    frozen_map->tgid_bucket[tgid] = bucket;
+    frozen_map->uids[bucket]++;
+    __atomic_store_n(&frozen_map->nr, frozen_map->nr + 1, __ATOMIC_RELAXED);
+    __atomic_fetch_or(word, mask, __ATOMIC_RELEASE);
+  } else if (!frozen && old) {
+    frozen_map->uids[frozen_map->tgid_bucket[tgid]]--;
+    __atomic_store_n(&frozen_map->nr, frozen_map->nr - 1, __ATOMIC_RELAXED);
+    __atomic_fetch_and(word, ~mask, __ATOMIC_RELEASE);
+  }
+  spin_unlock(&frozen_map_lock);
+  rekernel_irq_restore(flags);
+  return frozen && !old;
+}
+
 // 判断线程是否进入 frozen 状态
 static inline bool frozen_task_group(struct task_struct* task) {
-  return (jobctl_frozen(task) || cgroup_freezing(task));
+  if (jobctl_frozen(task))
+    return true;
+  pid_t tgid = task_tgid_nr(task);
+  if (!__atomic_load_n(&frozen_map_ready, __ATOMIC_ACQUIRE) || tgid <= 0 || tgid >= FROZEN_PID_MAX)
+    return cgroup_freezing(task);
+  if (!frozen_tgid_test(tgid))
+    return false;
+  // 进程退出后 tgid 可能被复用, 命中时再次确认, 位只由 hook 修改
+  // cgroup_freeze_task 在设置 JOBCTL_TRAP_FREEZE 前已置位, 这里清除会丢失正在冻结的进程
+  return cgroup_freezing(task);
+}
+
+// 存在冻结的进程, 位图不可用时返回 true
+static inline bool frozen_any(void) {
+  if (!__atomic_load_n(&frozen_map_ready, __ATOMIC_ACQUIRE))
+    return true;
+  return __atomic_load_n(&frozen_map->nr, __ATOMIC_RELAXED) != 0;
+}
+
+// uid 可能存在冻结的进程, 哈希冲突时返回 true, 位图不可用时返回 true
+static inline bool frozen_uid_maybe(uid_t uid) {
+  if (!__atomic_load_n(&frozen_map_ready, __ATOMIC_ACQUIRE))
+    return true;
+  return __atomic_load_n(&frozen_map->uids[frozen_uid_bucket(uid)], __ATOMIC_RELAXED) != 0;
+}
+
+static inline void rekernel_wake_flush(void);
+#ifdef CONFIG_NETWORK
+static void network_window_reset(uid_t uid);
+#endif /* CONFIG_NETWORK */
+// freeze hook 中可能关中断, 由 flush 线程清理
+static void binder_sweep_request(struct task_struct* task) {
+  if (!binder_sweep_supported)
+    return;
+  pid_t tgid = task_tgid_nr(task);
+  __atomic_fetch_or(&frozen_map->sweep[tgid / FROZEN_LONG_BITS], 1UL << (tgid % FROZEN_LONG_BITS), __ATOMIC_RELEASE);
+  __atomic_store_n(&binder_sweep_pending, true, __ATOMIC_RELEASE);
+  rekernel_wake_flush();
+}
+
+// 进程刚进入冻结状态
+static void frozen_map_enter(struct task_struct* task, bool sweep) {
+#ifdef CONFIG_NETWORK
+  network_window_reset(task_uid(task).val);
+#endif /* CONFIG_NETWORK */
+  if (sweep) {
+    binder_sweep_request(task);
+  }
+}
+
+static void freeze_task_before(hook_fargs1_t* args, void* udata) {
+  struct rekernel_hook_slot* slot = rekernel_hook_enter();
+  if (!slot)
+    return;
+  struct task_struct* task = (struct task_struct*)args->arg0;
+  // 系统休眠时也会调用 freeze_task, 只清理 cgroup 冻结的进程
+  if (frozen_map_set(task, true)) {
+    frozen_map_enter(task, cgroup_freezing(task));
+  }
+  rekernel_hook_exit(slot);
+}
+
+static void thaw_task_before(hook_fargs1_t* args, void* udata) {
+  struct rekernel_hook_slot* slot = rekernel_hook_enter();
+  if (!slot)
+    return;
+  struct task_struct* task = (struct task_struct*)args->arg0;
+  // 系统休眠唤醒时 cgroupv1 和 cgroupv2 冻结的进程仍然处于冻结状态
+  if (!cgroup_freezing(task) && !jobctl_frozen(task)) {
+    frozen_map_set(task, false);
+  }
+  rekernel_hook_exit(slot);
+}
+
+static void cgroup_freeze_task_before(hook_fargs2_t* args, void* udata) {
+  struct rekernel_hook_slot* slot = rekernel_hook_enter();
+  if (!slot)
+    return;
+  struct task_struct* task = (struct task_struct*)args->arg0;
+  if (frozen_map_set(task, (bool)args->arg1)) {
+    frozen_map_enter(task, true);
+  }
+  rekernel_hook_exit(slot);
+}
+
+// 冻结的进程被杀死时不会解冻, 在 tgid 可以被复用前清除
+static void release_task_before(hook_fargs1_t* args, void* udata) {
+  struct task_struct* task = (struct task_struct*)args->arg0;
+  pid_t tgid = task_tgid_nr(task);
+  if (task_pid_nr(task) != tgid || tgid <= 0 || tgid >= FROZEN_PID_MAX)
+    return;
+  struct rekernel_hook_slot* slot = rekernel_hook_enter();
+  if (!slot)
+    return;
+  if (frozen_tgid_test(tgid)) {
+    frozen_map_set(task, false);
+  }
+  rekernel_hook_exit(slot);
+}
+
+// 加载前已冻结的进程, 与 for_each_process 相同沿 init_task.tasks 遍历线程组 leader
+// 缺少 init_task 或 tasks 偏移时返回 false, 位图不可信
+static bool frozen_map_scan(void) {
+  struct task_struct* init = kvar(init_task);
+  int16_t tasks_offset = task_struct_offset.tasks_offset;
+  if (!init || tasks_offset <= 0)
+    return false;
+
+  struct list_head* head = (struct list_head*)((uintptr_t)init + tasks_offset);
+  rcu_read_lock();
+  for (struct list_head* pos = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE); pos != head;
+       pos = __atomic_load_n(&pos->next, __ATOMIC_ACQUIRE)) {
+    struct task_struct* task = (struct task_struct*)((uintptr_t)pos - tasks_offset);
+    if (jobctl_frozen(task) || cgroup_freezing(task)) {
+      frozen_map_set(task, true);
+    }
+  }
+  rcu_read_unlock();
+  return true;
 }
 
 // netlink
 static int netlink_count = 0;
 static struct sock* rekernel_netlink;
 static unsigned long rekernel_netlink_unit = UZERO;
-static struct proc_dir_entry *rekernel_dir, *rekernel_unit_entry;
+static struct proc_dir_entry *rekernel_dir, *rekernel_unit_entry, *rekernel_mmap_entry, *rekernel_latency_entry,
+    *rekernel_reclaim_entry;
 static const struct file_operations rekernel_unit_fops = {};
+// 守护进程选择的事件格式
+static int rekernel_format = REKERNEL_FORMAT_TEXT;
+// USER_PORT 是否存在, 发送失败时置 false, 收到 hello 时恢复
+static bool rekernel_unicast_alive = true;
+// /proc/rekernel/events 共享内存, 打开期间代替 USER_PORT
+static struct rekernel_mmap_header* rekernel_mmap;
+static struct wait_queue_head rekernel_mmap_wait;
+static int rekernel_mmap_users;
+static uint32_t rekernel_mmap_head, rekernel_mmap_woken;
+static int rekernel_unicast(struct sk_buff* skbuffer, u32 portid) {
+  int rc = netlink_unicast(rekernel_netlink, skbuffer, portid, MSG_DONTWAIT);
+  if (rc == -ECONNREFUSED && portid == USER_PORT) {
+    rekernel_unicast_alive = false;
+  }
+  return rc;
+}
 // 发送 netlink 消息
-static int send_netlink_message(char* msg) {
-  int len = strlen(msg);
+static int send_netlink_data(const void* data, int len, int type, u32 portid) {
   struct sk_buff* skbuffer;
   struct nlmsghdr* nlhdr;
 
@@ -199,15 +549,528 @@ static int send_netlink_message(char* msg) {
     return -ENOMEM;
   }
 
-  nlhdr = nlmsg_put(skbuffer, 0, 0, rekernel_netlink_unit, len, 0);
+  nlhdr = nlmsg_put(skbuffer, 0, 0, type, len, 0);
   if (!nlhdr) {
     logkm("nlmsg_put failaure.\n");
     nlmsg_free(skbuffer);
     return -EMSGSIZE;
   }
 
-  memcpy(nlmsg_data(nlhdr), msg, len);
-  return netlink_unicast(rekernel_netlink, skbuffer, USER_PORT, MSG_DONTWAIT);
+  memcpy(nlmsg_data(nlhdr), data, len);
+  return rekernel_unicast(skbuffer, portid);
+}
+static int send_netlink_message(char* msg) {
+  return send_netlink_data(msg, strlen(msg), rekernel_netlink_unit, USER_PORT);
+}
+// 批量发送
+#define REKERNEL_BATCH_SIZE 4096
+static unsigned int rekernel_batch_deadline = 2, rekernel_batch_events = 32;
+// 合并窗口, 单位 ns, 0 表示关闭
+static u64 rekernel_coalesce_window;
+static bool rekernel_thaw_dedup;
+// 每个重复的异步消息保留的数量, 包括新的消息, 0 表示不清理
+static unsigned int binder_reclaim_keep = 2;
+#ifdef CONFIG_NETWORK
+// 网络事件按 uid 合并的窗口, 单位 ns, 0 表示每个包都上报
+static u64 network_interval = 1000 * 1000000ULL;
+#endif /* CONFIG_NETWORK */
+// group 为 0 时发送给 USER_PORT, 否则广播到对应 group
+struct rekernel_batch {
+  struct sk_buff* skb;
+  int len;
+  int count;
+  u32 group;
+};
+static int rekernel_batch_flush(struct rekernel_batch* batch) {
+  if (!batch->skb)
+    return 0;
+
+  struct sk_buff* skbuffer = batch->skb;
+  int count = batch->count;
+  batch->skb = NULL;
+  batch->len = 0;
+  batch->count = 0;
+  if (!count) {
+    nlmsg_free(skbuffer);
+    return 0;
+  }
+  // 预留了 NLMSG_DONE 的空间
+  nlmsg_put(skbuffer, 0, 0, NLMSG_DONE, 0, NLM_F_MULTI);
+  if (batch->group)
+    return netlink_broadcast(rekernel_netlink, skbuffer, 0, batch->group, GFP_ATOMIC);
+  return rekernel_unicast(skbuffer, USER_PORT);
+}
+static inline bool rekernel_batch_room(struct rekernel_batch* batch, int len) {
+  return !batch->skb || batch->len + nlmsg_total_size(len) + nlmsg_total_size(0) <= REKERNEL_BATCH_SIZE;
+}
+static int rekernel_batch_add(struct rekernel_batch* batch, const void* data, int len, int type) {
+  int size = nlmsg_total_size(len);
+  if (size + nlmsg_total_size(0) > REKERNEL_BATCH_SIZE)
+    return -EMSGSIZE;
+
+  int rc = 0;
+  if (!rekernel_batch_room(batch, len)) {
+    rc = rekernel_batch_flush(batch);
+  }
+  if (!batch->skb) {
+    batch->skb = alloc_skb(REKERNEL_BATCH_SIZE, GFP_ATOMIC);
+    if (!batch->skb) {
+      logkm("netlink alloc failure.\n");
+      return -ENOMEM;
+    }
+  }
+
+  // __nlmsg_put 不检查剩余空间, 由 batch->len 保证
+  struct nlmsghdr* nlhdr = nlmsg_put(batch->skb, 0, 0, type, len, NLM_F_MULTI);
+  if (!nlhdr) {
+    logkm("nlmsg_put failaure.\n");
+    return -EMSGSIZE;
+  }
+  memcpy(nlmsg_data(nlhdr), data, len);
+  batch->len += size;
+  batch->count++;
+  return rc;
+}
+// 事件到 ack 的延迟, 第 i 个桶为 [2^(i-1), 2^i) us, 最后一个桶为更大的值
+static struct rekernel_latency {
+  uint32_t count;
+  u64 max_us;
+  uint32_t buckets[REKERNEL_LATENCY_BUCKETS];
+} rekernel_latency;
+// 最近发送的事件的 seq 和 timestamp, 按 seq 直接映射, 每个 seq 只统计一次 ack
+struct rekernel_ack_entry {
+  uint32_t seq;
+  u64 timestamp;
+};
+static struct rekernel_ack_entry rekernel_ack_table[REKERNEL_ACK_SIZE];
+static spinlock_t rekernel_ack_lock;
+
+static void rekernel_ack_record(uint32_t seq, u64 timestamp) {
+  struct rekernel_ack_entry* entry = &rekernel_ack_table[seq & (REKERNEL_ACK_SIZE - 1)];
+  spin_lock(&rekernel_ack_lock);
+  entry->seq = seq;
+  entry->timestamp = timestamp;
+  spin_unlock(&rekernel_ack_lock);
+}
+// 返回 seq 对应事件的 timestamp, 已被覆盖, 已 ack 或 timestamp 不一致时返回 0
+static u64 rekernel_ack_take(uint32_t seq, u64 timestamp) {
+  struct rekernel_ack_entry* entry = &rekernel_ack_table[seq & (REKERNEL_ACK_SIZE - 1)];
+  u64 ret = 0;
+  spin_lock(&rekernel_ack_lock);
+  if (entry->seq == seq && entry->timestamp && entry->timestamp == timestamp) {
+    ret = entry->timestamp;
+    entry->timestamp = 0;
+  }
+  spin_unlock(&rekernel_ack_lock);
+  return ret;
+}
+static void rekernel_latency_add(u64 timestamp) {
+  u64 now = ktime_get_mono_fast_ns();
+  if (!timestamp || timestamp > now)
+    return;
+
+  u64 us = (now - timestamp) / 1000;
+  int bucket = us ? 64 - __builtin_clzll(us) : 0;
+  if (bucket >= REKERNEL_LATENCY_BUCKETS) {
+    bucket = REKERNEL_LATENCY_BUCKETS - 1;
+  }
+  __atomic_fetch_add(&rekernel_latency.buckets[bucket], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&rekernel_latency.count, 1, __ATOMIC_RELAXED);
+  u64 max_us = __atomic_load_n(&rekernel_latency.max_us, __ATOMIC_RELAXED);
+  while (us > max_us
+         && !__atomic_compare_exchange_n(&rekernel_latency.max_us, &max_us, us, true, __ATOMIC_RELAXED,
+                                         __ATOMIC_RELAXED)) {
+  }
+}
+// 清理过时消息的统计, 每个 cpu 一份, 写入时屏蔽中断
+// 按 (目标 uid, code) 记录, 槽位用完后计入 other, 超出预算释放的消息单独计数
+struct reclaim_cpu_stats {
+  u64 count;
+  u64 bytes;
+  u64 other_count;
+  u64 other_bytes;
+  u64 budget_count;
+  u64 budget_bytes;
+  struct rekernel_reclaim_entry slots[RECLAIM_STATS_SLOTS];
+};
+static struct reclaim_cpu_stats* reclaim_stats;
+static unsigned int reclaim_nr_stats;
+
+static void reclaim_stats_add(uid_t uid, u32 code, u64 bytes) {
+  if (unlikely(!reclaim_stats))
+    return;
+  unsigned long flags = rekernel_irq_save();
+  int cpu = *(int*)((uintptr_t)kvar(cpu_number) + rekernel_cpu_offset());
+  if (likely(cpu >= 0 && cpu < reclaim_nr_stats)) {
+    struct reclaim_cpu_stats* stats = &reclaim_stats[cpu];
+    stats->count++;
+    stats->bytes += bytes;
+    unsigned int start = (uid * 31 + code) & (RECLAIM_STATS_SLOTS - 1);
+    struct rekernel_reclaim_entry* entry = NULL;
+    for (int i = 0; i < RECLAIM_STATS_SLOTS; i++) {
+      struct rekernel_reclaim_entry* slot = &stats->slots[(start + i) & (RECLAIM_STATS_SLOTS - 1)];
+      if (!slot->count || (slot->uid == uid && slot->code == code)) {
+        entry = slot;
+        break;
+      }
+    }
+    if (entry) {
+      entry->uid = uid;
+      entry->code = code;
+      entry->bytes += bytes;
+      __atomic_store_n(&entry->count, entry->count + 1, __ATOMIC_RELEASE);
+    } else {
+      stats->other_count++;
+      stats->other_bytes += bytes;
+    }
+  }
+  rekernel_irq_restore(flags);
+}
+
+static void reclaim_stats_add_budget(u64 bytes) {
+  if (unlikely(!reclaim_stats))
+    return;
+  unsigned long flags = rekernel_irq_save();
+  int cpu = *(int*)((uintptr_t)kvar(cpu_number) + rekernel_cpu_offset());
+  if (likely(cpu >= 0 && cpu < reclaim_nr_stats)) {
+    reclaim_stats[cpu].budget_count++;
+    reclaim_stats[cpu].budget_bytes += bytes;
+  }
+  rekernel_irq_restore(flags);
+}
+
+static void reclaim_stats_budget(u64* count, u64* bytes) {
+  *count = 0;
+  *bytes = 0;
+  if (!reclaim_stats)
+    return;
+  for (int cpu = 0; cpu < reclaim_nr_stats; cpu++) {
+    *count += reclaim_stats[cpu].budget_count;
+    *bytes += reclaim_stats[cpu].budget_bytes;
+  }
+}
+
+static struct rekernel_reclaim_entry* reclaim_stats_find(struct reclaim_cpu_stats* stats, uid_t uid, u32 code) {
+  for (int i = 0; i < RECLAIM_STATS_SLOTS; i++) {
+    struct rekernel_reclaim_entry* slot = &stats->slots[i];
+    if (__atomic_load_n(&slot->count, __ATOMIC_ACQUIRE) && slot->uid == uid && slot->code == code)
+      return slot;
+  }
+  return NULL;
+}
+
+// 合并所有 cpu 的统计, 保留 bytes 最多的 REKERNEL_RECLAIM_STATS_MAX 个
+static void reclaim_stats_collect(struct rekernel_reclaim_stats* out) {
+  memset(out, 0, sizeof(*out));
+  if (!reclaim_stats)
+    return;
+
+  for (int cpu = 0; cpu < reclaim_nr_stats; cpu++) {
+    out->count += reclaim_stats[cpu].count;
+    out->bytes += reclaim_stats[cpu].bytes;
+    out->other_count += reclaim_stats[cpu].other_count;
+    out->other_bytes += reclaim_stats[cpu].other_bytes;
+
+    for (int i = 0; i < RECLAIM_STATS_SLOTS; i++) {
+      struct rekernel_reclaim_entry* slot = &reclaim_stats[cpu].slots[i];
+      if (!__atomic_load_n(&slot->count, __ATOMIC_ACQUIRE))
+        continue;
+      // 同一个 key 只在第一次出现的 cpu 上合并
+      bool seen = false;
+      for (int prev = 0; prev < cpu && !seen; prev++) {
+        seen = reclaim_stats_find(&reclaim_stats[prev], slot->uid, slot->code) != NULL;
+      }
+      if (seen)
+        continue;
+      struct rekernel_reclaim_entry sum = {.uid = slot->uid, .code = slot->code};
+      for (int next = cpu; next < reclaim_nr_stats; next++) {
+        struct rekernel_reclaim_entry* e = reclaim_stats_find(&reclaim_stats[next], sum.uid, sum.code);
+        if (e) {
+          sum.count += e->count;
+          sum.bytes += e->bytes;
+        }
+      }
+
+      // 按 bytes 降序插入, 超出的计入 other
+      int j = out->nr_entries < REKERNEL_RECLAIM_STATS_MAX ? out->nr_entries++ : REKERNEL_RECLAIM_STATS_MAX;
+      if (j == REKERNEL_RECLAIM_STATS_MAX) {
+        struct rekernel_reclaim_entry* last = &out->entries[REKERNEL_RECLAIM_STATS_MAX - 1];
+        if (sum.bytes <= last->bytes) {
+          out->other_count += sum.count;
+          out->other_bytes += sum.bytes;
+          continue;
+        }
+        out->other_count += last->count;
+        out->other_bytes += last->bytes;
+        j--;
+      }
+      for (; j > 0 && out->entries[j - 1].bytes < sum.bytes; j--) {
+        out->entries[j] = out->entries[j - 1];
+      }
+      out->entries[j] = sum;
+    }
+  }
+}
+
+// 事件过滤, 写者持有 rekernel_filter_lock, 读者通过 seq 检测并发修改
+// 读者可能运行在软中断中, 不能等待写者, 修改期间的事件直接放行
+static struct rekernel_filter {
+  uint32_t seq;
+  uint32_t types;
+  uint32_t nr_uids;
+  uint32_t nr_ranges;
+  struct rekernel_code_range ranges[REKERNEL_FILTER_MAX_RANGES];
+  uid_t uids[REKERNEL_FILTER_MAX_UIDS];
+} rekernel_filter = {
+    .types = REKERNEL_FILTER_ALL,
+    .nr_ranges = 1,
+    .ranges = { { 29, 32 } },
+};
+static spinlock_t rekernel_filter_lock;
+
+static inline uint32_t rekernel_filter_type(int reporttype, int type) {
+  switch (reporttype) {
+    case BINDER:
+      return type == BUDGET ? REKERNEL_FILTER_BINDER_OVERFLOW : REKERNEL_FILTER_BINDER_REPLY << type;
+    case SIGNAL:
+      return REKERNEL_FILTER_SIGNAL;
+    default:
+      return REKERNEL_FILTER_NETWORK;
+  }
+}
+static inline bool rekernel_filter_match_type(int reporttype, int type) {
+  return __atomic_load_n(&rekernel_filter.types, __ATOMIC_RELAXED) & rekernel_filter_type(reporttype, type);
+}
+// uids 已排序, 二分查找
+static bool rekernel_filter_match_uid(uid_t uid) {
+  uint32_t seq = __atomic_load_n(&rekernel_filter.seq, __ATOMIC_ACQUIRE);
+  if (seq & 1)
+    return true;
+
+  bool match = true;
+  uint32_t nr_uids = rekernel_filter.nr_uids;
+  if (nr_uids && nr_uids <= REKERNEL_FILTER_MAX_UIDS) {
+    uint32_t lo = 0, hi = nr_uids;
+    match = false;
+    while (lo < hi) {
+      uint32_t mid = (lo + hi) / 2;
+      uid_t val = rekernel_filter.uids[mid];
+      if (val == uid) {
+        match = true;
+        break;
+      }
+      if (val < uid) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+  }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&rekernel_filter.seq, __ATOMIC_RELAXED) != seq || match;
+}
+static bool rekernel_filter_match_code(uint32_t code) {
+  uint32_t seq = __atomic_load_n(&rekernel_filter.seq, __ATOMIC_ACQUIRE);
+  if (seq & 1)
+    return true;
+
+  bool match = true;
+  uint32_t nr_ranges = rekernel_filter.nr_ranges;
+  if (nr_ranges && nr_ranges <= REKERNEL_FILTER_MAX_RANGES) {
+    match = false;
+    for (uint32_t i = 0; i < nr_ranges; i++) {
+      if (code >= rekernel_filter.ranges[i].start && code <= rekernel_filter.ranges[i].end) {
+        match = true;
+        break;
+      }
+    }
+  }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&rekernel_filter.seq, __ATOMIC_RELAXED) != seq || match;
+}
+static int rekernel_filter_update(struct rekernel_ctl_filter* ctl) {
+  if (ctl->nr_uids > REKERNEL_FILTER_MAX_UIDS || ctl->nr_ranges > REKERNEL_FILTER_MAX_RANGES)
+    return -EINVAL;
+  for (int i = 0; i < ctl->nr_ranges; i++) {
+    if (ctl->ranges[i].start > ctl->ranges[i].end)
+      return -EINVAL;
+  }
+
+  // 插入排序, 最多 REKERNEL_FILTER_MAX_UIDS 个
+  uid_t uids[REKERNEL_FILTER_MAX_UIDS];
+  for (int i = 0; i < ctl->nr_uids; i++) {
+    uid_t uid = ctl->uids[i];
+    int j = i;
+    for (; j > 0 && uids[j - 1] > uid; j--) {
+      uids[j] = uids[j - 1];
+    }
+    uids[j] = uid;
+  }
+
+  spin_lock(&rekernel_filter_lock);
+  uint32_t seq = rekernel_filter.seq;
+  __atomic_store_n(&rekernel_filter.seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&rekernel_filter.types, ctl->types & REKERNEL_FILTER_ALL, __ATOMIC_RELAXED);
+  rekernel_filter.nr_uids = ctl->nr_uids;
+  rekernel_filter.nr_ranges = ctl->nr_ranges;
+  memcpy(rekernel_filter.uids, uids, sizeof(uid_t) * ctl->nr_uids);
+  memcpy(rekernel_filter.ranges, ctl->ranges, sizeof(struct rekernel_code_range) * ctl->nr_ranges);
+  __atomic_store_n(&rekernel_filter.seq, seq + 2, __ATOMIC_RELEASE);
+  spin_unlock(&rekernel_filter_lock);
+  return 0;
+}
+// 冻结进程异步消息的字节预算, 写者和读者都持有 binder_budget_lock, bytes 可以不加锁预先判断
+static struct binder_budget {
+  uint32_t bytes;
+  uint32_t nr_ranges;
+  uint32_t nr_names;
+  struct rekernel_code_range ranges[REKERNEL_BUDGET_MAX_RANGES];
+  char names[REKERNEL_BUDGET_MAX_NAMES][REKERNEL_BUDGET_NAME_LEN];
+} binder_budget;
+static spinlock_t binder_budget_lock;
+
+static int binder_budget_update(struct rekernel_ctl_budget* ctl) {
+  if (ctl->nr_ranges > REKERNEL_BUDGET_MAX_RANGES || ctl->nr_names > REKERNEL_BUDGET_MAX_NAMES)
+    return -EINVAL;
+  for (int i = 0; i < ctl->nr_ranges; i++) {
+    if (ctl->ranges[i].start > ctl->ranges[i].end)
+      return -EINVAL;
+  }
+  for (int i = 0; i < ctl->nr_names; i++) {
+    if (ctl->names[i][0] == '\0' || ctl->names[i][REKERNEL_BUDGET_NAME_LEN - 1] != '\0')
+      return -EINVAL;
+  }
+
+  spin_lock(&binder_budget_lock);
+  __atomic_store_n(&binder_budget.bytes, ctl->bytes, __ATOMIC_RELAXED);
+  binder_budget.nr_ranges = ctl->nr_ranges;
+  __atomic_store_n(&binder_budget.nr_names, ctl->nr_names, __ATOMIC_RELAXED);
+  memcpy(binder_budget.ranges, ctl->ranges, sizeof(struct rekernel_code_range) * ctl->nr_ranges);
+  memcpy(binder_budget.names, ctl->names, REKERNEL_BUDGET_NAME_LEN * ctl->nr_names);
+  spin_unlock(&binder_budget_lock);
+  return 0;
+}
+// portid 由内核按发送者的 socket 填写, nlmsg_pid 可以伪造
+// 只有 USER_PORT 且具有 CAP_NET_ADMIN 的守护进程可以修改全局配置
+static inline bool rekernel_ctl_trusted(struct sk_buff* skb, u32 portid) {
+  return portid == USER_PORT && netlink_capable(skb, CAP_NET_ADMIN);
+}
+// 处理守护进程的控制消息
+static int netlink_rcv_ctl(struct sk_buff* skb, struct rekernel_ctl* ctl, int len) {
+  u32 portid = NETLINK_CB(skb).portid;
+  // HELLO 和 RECLAIM_STATS 只回复发送者, 其余命令修改全局状态, 只接受 USER_PORT
+  if (ctl->cmd != REKERNEL_CTL_HELLO && ctl->cmd != REKERNEL_CTL_RECLAIM_STATS && !rekernel_ctl_trusted(skb, portid))
+    return -EPERM;
+  switch (ctl->cmd) {
+    case REKERNEL_CTL_HELLO: {
+      if (len < sizeof(struct rekernel_ctl_hello))
+        return -EINVAL;
+      struct rekernel_ctl_hello* hello = (struct rekernel_ctl_hello*)ctl;
+      if (hello->format != REKERNEL_FORMAT_TEXT && hello->format != REKERNEL_FORMAT_BINARY)
+        return -EINVAL;
+      // 只有 USER_PORT 可以修改格式, 其他订阅者总是使用二进制格式
+      if (rekernel_ctl_trusted(skb, portid)) {
+        rekernel_format = hello->format;
+        rekernel_unicast_alive = true;
+      }
+
+      netlink_count++;
+      char netlink_kmsg[PACKET_SIZE];
+      snprintf(netlink_kmsg, sizeof(netlink_kmsg), "Successfully received data packet! %d,format=%d,version=%d",
+               netlink_count, portid == USER_PORT ? rekernel_format : REKERNEL_FORMAT_BINARY, REKERNEL_EVENT_VERSION);
+      logkm("kernel recv hello from user: port=%d,format=%d\n", portid, hello->format);
+      return send_netlink_data(netlink_kmsg, strlen(netlink_kmsg), rekernel_netlink_unit, portid);
+    }
+    case REKERNEL_CTL_BATCH: {
+      if (len < sizeof(struct rekernel_ctl_batch))
+        return -EINVAL;
+      struct rekernel_ctl_batch* batch = (struct rekernel_ctl_batch*)ctl;
+      if (batch->max_events == 0 || batch->max_events > REKERNEL_RING_SIZE || batch->deadline_ms > 1000)
+        return -EINVAL;
+      rekernel_batch_deadline = batch->deadline_ms;
+      rekernel_batch_events = batch->max_events;
+      logkm("batch deadline_ms=%d,max_events=%d\n", rekernel_batch_deadline, rekernel_batch_events);
+      return 0;
+    }
+    case REKERNEL_CTL_COALESCE: {
+      if (len < sizeof(struct rekernel_ctl_coalesce))
+        return -EINVAL;
+      struct rekernel_ctl_coalesce* coalesce = (struct rekernel_ctl_coalesce*)ctl;
+      if (coalesce->window_ms > 60 * 1000)
+        return -EINVAL;
+      __atomic_store_n(&rekernel_coalesce_window, (u64)coalesce->window_ms * 1000000, __ATOMIC_RELAXED);
+      logkm("coalesce window_ms=%d\n", coalesce->window_ms);
+      return 0;
+    }
+    case REKERNEL_CTL_THAW_DEDUP: {
+      if (len < sizeof(struct rekernel_ctl_thaw_dedup))
+        return -EINVAL;
+      struct rekernel_ctl_thaw_dedup* dedup = (struct rekernel_ctl_thaw_dedup*)ctl;
+      __atomic_store_n(&rekernel_thaw_dedup, dedup->enable != 0, __ATOMIC_RELAXED);
+      logkm("thaw dedup enable=%d\n", dedup->enable);
+      return 0;
+    }
+    case REKERNEL_CTL_RECLAIM: {
+      if (len < sizeof(struct rekernel_ctl_reclaim))
+        return -EINVAL;
+      struct rekernel_ctl_reclaim* reclaim = (struct rekernel_ctl_reclaim*)ctl;
+      if (reclaim->keep > BINDER_RECLAIM_KEEP_MAX)
+        return -EINVAL;
+      __atomic_store_n(&binder_reclaim_keep, reclaim->keep, __ATOMIC_RELAXED);
+      logkm("reclaim keep=%d\n", reclaim->keep);
+      return 0;
+    }
+    case REKERNEL_CTL_BUDGET: {
+      if (len < sizeof(struct rekernel_ctl_budget))
+        return -EINVAL;
+      struct rekernel_ctl_budget* budget = (struct rekernel_ctl_budget*)ctl;
+      int rc = binder_budget_update(budget);
+      logkm("budget bytes=%d,nr_ranges=%d,nr_names=%d,rc=%d\n", budget->bytes, budget->nr_ranges, budget->nr_names,
+            rc);
+      return rc;
+    }
+#ifdef CONFIG_NETWORK
+    case REKERNEL_CTL_NETWORK: {
+      if (len < sizeof(struct rekernel_ctl_network))
+        return -EINVAL;
+      struct rekernel_ctl_network* network = (struct rekernel_ctl_network*)ctl;
+      if (network->interval_ms > 60 * 1000)
+        return -EINVAL;
+      __atomic_store_n(&network_interval, (u64)network->interval_ms * 1000000, __ATOMIC_RELAXED);
+      logkm("network interval_ms=%d\n", network->interval_ms);
+      return 0;
+    }
+#endif /* CONFIG_NETWORK */
+    case REKERNEL_CTL_RECLAIM_STATS: {
+      struct rekernel_reclaim_stats* stats = vzalloc(sizeof(struct rekernel_reclaim_stats));
+      if (!stats)
+        return -ENOMEM;
+      reclaim_stats_collect(stats);
+      size_t size = sizeof(*stats) - sizeof(stats->entries) + sizeof(stats->entries[0]) * stats->nr_entries;
+      int rc = send_netlink_data(stats, size, REKERNEL_MSG_RECLAIM_STATS, portid);
+      vfree(stats);
+      return rc;
+    }
+    case REKERNEL_CTL_ACK: {
+      if (len < sizeof(struct rekernel_ctl_ack))
+        return -EINVAL;
+      struct rekernel_ctl_ack* ack = (struct rekernel_ctl_ack*)ctl;
+      rekernel_latency_add(rekernel_ack_take(ack->seq, ack->timestamp));
+      return 0;
+    }
+    case REKERNEL_CTL_FILTER: {
+      if (len < sizeof(struct rekernel_ctl_filter))
+        return -EINVAL;
+      struct rekernel_ctl_filter* filter = (struct rekernel_ctl_filter*)ctl;
+      int rc = rekernel_filter_update(filter);
+      logkm("filter types=0x%x,nr_uids=%d,nr_ranges=%d,rc=%d\n", filter->types, filter->nr_uids, filter->nr_ranges,
+            rc);
+      return rc;
+    }
+    default:
+      return -EINVAL;
+  }
 }
 // 接收 netlink 消息
 static int netlink_rcv_msg(struct sk_buff* skb, struct nlmsghdr* nlh, struct netlink_ext_ack* extack) {
@@ -215,6 +1078,16 @@ static int netlink_rcv_msg(struct sk_buff* skb, struct nlmsghdr* nlh, struct net
   if (!umsg)
     return -EINVAL;
 
+  int len = nlh->nlmsg_len - NLMSG_HDRLEN;
+  struct rekernel_ctl* ctl = (struct rekernel_ctl*)umsg;
+  if (len >= (int)sizeof(struct rekernel_ctl) && ctl->magic == REKERNEL_MAGIC)
+    return netlink_rcv_ctl(skb, ctl, len);
+
+  // 旧守护进程只发送文本 hello, 同样只接受 USER_PORT
+  if (!rekernel_ctl_trusted(skb, NETLINK_CB(skb).portid))
+    return -EPERM;
+  rekernel_format = REKERNEL_FORMAT_TEXT;
+  rekernel_unicast_alive = true;
   netlink_count++;
   char netlink_kmsg[PACKET_SIZE];
   snprintf(netlink_kmsg, sizeof(netlink_kmsg), "Successfully received data packet! %d", netlink_count);
@@ -222,11 +1095,151 @@ static int netlink_rcv_msg(struct sk_buff* skb, struct nlmsghdr* nlh, struct net
   return send_netlink_message(netlink_kmsg);
 }
 static void netlink_rcv(struct sk_buff* skb) { netlink_rcv_skb(skb, &netlink_rcv_msg); }
+static int rekernel_mmap_open(struct inode* inode, struct file* file) {
+  if (!rekernel_mmap)
+    return -ENOMEM;
+  int users = 0;
+  if (!__atomic_compare_exchange_n(&rekernel_mmap_users, &users, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    return -EBUSY;
+  return 0;
+}
+static int rekernel_mmap_release(struct inode* inode, struct file* file) {
+  __atomic_store_n(&rekernel_mmap_users, 0, __ATOMIC_RELEASE);
+  return 0;
+}
+static __poll_t rekernel_mmap_poll(struct file* file, struct poll_table_struct* wait) {
+  poll_wait(file, &rekernel_mmap_wait, wait);
+  if (__atomic_load_n(&rekernel_mmap->head, __ATOMIC_ACQUIRE) != __atomic_load_n(&rekernel_mmap->tail, __ATOMIC_RELAXED))
+    return EPOLLIN | EPOLLRDNORM;
+  return 0;
+}
+// vm_insert_page 持有页面引用, 卸载后用户态的映射仍然有效
+static int rekernel_mmap_mmap(struct file* file, struct vm_area_struct* vma) {
+  return remap_vmalloc_range(vma, rekernel_mmap, 0);
+}
+static const struct proc_ops rekernel_mmap_ops = {
+    .proc_open = rekernel_mmap_open,
+    .proc_release = rekernel_mmap_release,
+    .proc_poll = rekernel_mmap_poll,
+    .proc_mmap = rekernel_mmap_mmap,
+};
+// 5.10 以下 proc_create 使用 file_operations, 布局差异较大, 不支持
+static void start_rekernel_mmap(void) {
+  if (!kfunc(seq_read_iter)) {
+    logkm("/proc/rekernel/events requires 5.10+\n");
+    return;
+  }
+
+  rekernel_mmap = vmalloc_user(REKERNEL_MMAP_DATA_OFFSET + REKERNEL_MMAP_RECORDS * REKERNEL_MMAP_RECORD_SIZE);
+  if (!rekernel_mmap) {
+    logkm("alloc /proc/rekernel/events failed!\n");
+    return;
+  }
+  rekernel_mmap->magic = REKERNEL_MMAP_MAGIC;
+  rekernel_mmap->version = REKERNEL_EVENT_VERSION;
+  rekernel_mmap->record_size = REKERNEL_MMAP_RECORD_SIZE;
+  rekernel_mmap->nr_records = REKERNEL_MMAP_RECORDS;
+  rekernel_mmap->data_offset = REKERNEL_MMAP_DATA_OFFSET;
+  init_waitqueue_head(&rekernel_mmap_wait);
+
+  rekernel_mmap_entry =
+      proc_create("events", 0600, rekernel_dir, (const struct file_operations*)&rekernel_mmap_ops);
+  if (!rekernel_mmap_entry) {
+    logkm("create /proc/rekernel/events failed!\n");
+    vfree(rekernel_mmap);
+    rekernel_mmap = NULL;
+  }
+}
+// 输出缓冲区不放在内核栈上
+#define REKERNEL_PROC_BUF_SIZE 2048
+static ssize_t rekernel_latency_read(struct file* file, char __user* buf, size_t count, loff_t* ppos) {
+  char* kbuf = vzalloc(REKERNEL_PROC_BUF_SIZE);
+  if (!kbuf)
+    return -ENOMEM;
+  size_t size = REKERNEL_PROC_BUF_SIZE;
+  int len = snprintf(kbuf, size, "count=%u\nmax_us=%llu\n", rekernel_latency.count,
+                     (unsigned long long)rekernel_latency.max_us);
+  for (int i = 0; i < REKERNEL_LATENCY_BUCKETS; i++) {
+    if (i < REKERNEL_LATENCY_BUCKETS - 1) {
+      len += snprintf(kbuf + len, size - len, "<%lluus %u\n", 1ULL << i, rekernel_latency.buckets[i]);
+    } else {
+      len += snprintf(kbuf + len, size - len, ">=%lluus %u\n", 1ULL << (i - 1), rekernel_latency.buckets[i]);
+    }
+  }
+  ssize_t rc = simple_read_from_buffer(buf, count, ppos, kbuf, len);
+  vfree(kbuf);
+  return rc;
+}
+static const struct proc_ops rekernel_latency_ops = {
+    .proc_read = rekernel_latency_read,
+};
+// 5.4 以下 file_operations 的 read 同样位于 0x10
+static struct file_operations rekernel_latency_fops;
+static void start_rekernel_latency(void) {
+  const struct file_operations* fops = (const struct file_operations*)&rekernel_latency_ops;
+  if (!kfunc(seq_read_iter)) {
+    *(void**)((uintptr_t)&rekernel_latency_fops + 0x10) = rekernel_latency_read;
+    fops = &rekernel_latency_fops;
+  }
+  rekernel_latency_entry = proc_create("latency", 0444, rekernel_dir, fops);
+  if (!rekernel_latency_entry) {
+    logkm("create /proc/rekernel/latency failed!\n");
+  }
+}
+// 统计和输出缓冲区都不放在内核栈上
+struct rekernel_reclaim_text {
+  struct rekernel_reclaim_stats stats;
+  char buf[REKERNEL_PROC_BUF_SIZE];
+};
+static ssize_t rekernel_reclaim_read(struct file* file, char __user* buf, size_t count, loff_t* ppos) {
+  struct rekernel_reclaim_text* text = vzalloc(sizeof(struct rekernel_reclaim_text));
+  if (!text)
+    return -ENOMEM;
+  struct rekernel_reclaim_stats* stats = &text->stats;
+  char* kbuf = text->buf;
+  size_t size = sizeof(text->buf);
+  reclaim_stats_collect(stats);
+  u64 budget_count, budget_bytes;
+  reclaim_stats_budget(&budget_count, &budget_bytes);
+  int len = snprintf(kbuf, size,
+                     "count=%llu\nbytes=%llu\nother_count=%llu\nother_bytes=%llu\n"
+                     "budget_count=%llu\nbudget_bytes=%llu\n",
+                     (unsigned long long)stats->count, (unsigned long long)stats->bytes,
+                     (unsigned long long)stats->other_count, (unsigned long long)stats->other_bytes,
+                     (unsigned long long)budget_count, (unsigned long long)budget_bytes);
+  for (int i = 0; i < stats->nr_entries && len < size; i++) {
+    len += snprintf(kbuf + len, size - len, "uid=%u,code=%u,count=%llu,bytes=%llu\n", stats->entries[i].uid,
+                    stats->entries[i].code, (unsigned long long)stats->entries[i].count,
+                    (unsigned long long)stats->entries[i].bytes);
+  }
+  if (len > size) {
+    len = size;
+  }
+  ssize_t rc = simple_read_from_buffer(buf, count, ppos, kbuf, len);
+  vfree(text);
+  return rc;
+}
+static const struct proc_ops rekernel_reclaim_ops = {
+    .proc_read = rekernel_reclaim_read,
+};
+static struct file_operations rekernel_reclaim_fops;
+static void start_rekernel_reclaim(void) {
+  const struct file_operations* fops = (const struct file_operations*)&rekernel_reclaim_ops;
+  if (!kfunc(seq_read_iter)) {
+    *(void**)((uintptr_t)&rekernel_reclaim_fops + 0x10) = rekernel_reclaim_read;
+    fops = &rekernel_reclaim_fops;
+  }
+  rekernel_reclaim_entry = proc_create("reclaim", 0444, rekernel_dir, fops);
+  if (!rekernel_reclaim_entry) {
+    logkm("create /proc/rekernel/reclaim failed!\n");
+  }
+}
 // 创建 netlink 服务
 static int start_rekernel_server(void) {
   if (rekernel_netlink_unit != UZERO)
     return 0;
   struct netlink_kernel_cfg rekernel_cfg = {
+      .groups = REKERNEL_GROUP_MAX,
       .input = netlink_rcv,
   };
 
@@ -253,128 +1266,1012 @@ static int start_rekernel_server(void) {
     if (!rekernel_unit_entry) {
       logkm("create rekernel unit failed!\n");
     }
+    start_rekernel_mmap();
+    start_rekernel_latency();
+    start_rekernel_reclaim();
   }
 
   return 0;
 }
 
-static void rekernel_report(int reporttype, int type, pid_t src_pid, struct task_struct* src, pid_t dst_pid,
-                            struct task_struct* dst, bool oneway) {
-  if (start_rekernel_server() != 0)
-    return;
-
+// 事件及其 rpc_name
+struct rekernel_event_buf {
+  struct rekernel_event ev;
+  union {
+    char rpc_name[INTERFACETOKEN_BUFF_SIZE];
+    struct rekernel_overflow overflow;
+    struct rekernel_budget budget;
+    struct rekernel_network network;
+  };
+};
+// rekernel_event 之后的数据大小
+static inline size_t rekernel_event_payload_size(const struct rekernel_event* ev) {
+  if (ev->reporttype == BINDER && ev->type == OVERFLOW)
+    return sizeof(struct rekernel_overflow);
+  if (ev->reporttype == BINDER && ev->type == BUDGET)
+    return sizeof(struct rekernel_budget);
 #ifdef CONFIG_NETWORK
-  if (reporttype == NETWORK) {
-    char binder_kmsg[PACKET_SIZE];
-    snprintf(binder_kmsg, sizeof(binder_kmsg), "type=Network,target=%d,proto=ipv%d;", dst_pid, src_pid);
-#ifdef CONFIG_DEBUG
-    logkm("%s\n", binder_kmsg);
-#endif /* CONFIG_DEBUG */
-    send_netlink_message(binder_kmsg);
-    return;
-  }
+  if (ev->reporttype == NETWORK)
+    return sizeof(struct rekernel_network);
 #endif /* CONFIG_NETWORK */
-
-  if (!frozen_task_group(dst))
-    return;
-
-  if (task_uid(src).val == task_uid(dst).val)
-    return;
-
-  char binder_kmsg[PACKET_SIZE];
-  switch (reporttype) {
+  return ev->rpc_name_len ? ev->rpc_name_len + 1 : 0;
+}
+// 复制到队列槽位, overflow 等事件的数据不是 rpc_name, 按类型复制, 至少包括 rpc_name 的 '\0'
+static inline void rekernel_event_copy(struct rekernel_event_buf* dst, const struct rekernel_event_buf* src) {
+  dst->ev = src->ev;
+  size_t payload_size = rekernel_event_payload_size(&src->ev);
+  memcpy(dst->rpc_name, src->rpc_name, payload_size ? payload_size : 1);
+}
+// 转换为旧守护进程使用的文本格式, 保持旧版本的记录, 新增的数据只在二进制格式中提供
+static void rekernel_event_to_text(const struct rekernel_event_buf* evb, char* kmsg, size_t size) {
+  const struct rekernel_event* ev = &evb->ev;
+  switch (ev->reporttype) {
     case BINDER:
-      if (oneway && type == TRANSACTION) {
-        if (ext_tr_offset == UZERO)
-          return;
-        struct task_ext* ext = get_task_ext(current);
-        struct binder_transaction_data* tr = *(void**)task_local_ptr(ext, ext_tr_offset);
-        if (!tr)
-          return;
-        // 减少异步消息
-        if (tr->code < 29 || tr->code > 32)
-          return;
-
-        size_t buf_data_size = tr->data_size > INTERFACETOKEN_BUFF_SIZE ? INTERFACETOKEN_BUFF_SIZE : tr->data_size;
-        char* buf_data = memdup_user((char*)tr->data.ptr.buffer, buf_data_size);
-        if (IS_ERR(buf_data))
-          return;
-        char buf[INTERFACETOKEN_BUFF_SIZE] = {0};
-        int i = 0;
-        int j = PARCEL_OFFSET + 1;
-        char* p = buf_data + PARCEL_OFFSET;
-        while (i < INTERFACETOKEN_BUFF_SIZE && j < buf_data_size && *p != '\0') {
-          buf[i++] = *p;
-          j += 2;
-          p += 2;
-        }
-        kvfree(buf_data);
-        if (i == INTERFACETOKEN_BUFF_SIZE) {
-          buf[i - 1] = '\0';
-        }
-        snprintf(binder_kmsg, sizeof(binder_kmsg),
+      if (ev->oneway && ev->type == TRANSACTION) {
+        snprintf(kmsg, size,
                  "type=Binder,bindertype=%s,oneway=%d,from_pid=%d,from=%d,target_pid=%d,target=%d,"
                  "rpc_name=%s,code=%d;",
-                 binder_type[type], oneway, src_pid, task_uid(src).val, dst_pid, task_uid(dst).val, buf, tr->code);
+                 binder_type[ev->type], ev->oneway, ev->src_pid, ev->src_uid, ev->dst_pid, ev->dst_uid, evb->rpc_name,
+                 ev->code);
       } else {
-        snprintf(binder_kmsg, sizeof(binder_kmsg),
-                 "type=Binder,bindertype=%s,oneway=%d,from_pid=%d,from=%d,target_pid=%d,target=%d;", binder_type[type],
-                 oneway, src_pid, task_uid(src).val, dst_pid, task_uid(dst).val);
+        snprintf(kmsg, size, "type=Binder,bindertype=%s,oneway=%d,from_pid=%d,from=%d,target_pid=%d,target=%d;",
+                 binder_type[ev->type], ev->oneway, ev->src_pid, ev->src_uid, ev->dst_pid, ev->dst_uid);
       }
       break;
     case SIGNAL:
-      snprintf(binder_kmsg, sizeof(binder_kmsg), "type=Signal,signal=%d,killer_pid=%d,killer=%d,dst_pid=%d,dst=%d;",
-               type, src_pid, task_uid(src).val, dst_pid, task_uid(dst).val);
+      snprintf(kmsg, size, "type=Signal,signal=%d,killer_pid=%d,killer=%d,dst_pid=%d,dst=%d;", ev->type, ev->src_pid,
+               ev->src_uid, ev->dst_pid, ev->dst_uid);
+      break;
+#ifdef CONFIG_NETWORK
+    case NETWORK:
+      snprintf(kmsg, size, "type=Network,target=%d,proto=ipv%d;", ev->dst_uid, ev->type);
       break;
+#endif /* CONFIG_NETWORK */
     default:
-      return;
+      kmsg[0] = '\0';
+      break;
+  }
+}
+// 事件所属的多播 group
+static inline int rekernel_event_group(int reporttype, int type) {
+  switch (reporttype) {
+    case BINDER:
+      return type == OVERFLOW || type == BUDGET ? REKERNEL_GROUP_OVERFLOW : REKERNEL_GROUP_BINDER;
+    case SIGNAL:
+      return REKERNEL_GROUP_SIGNAL;
+    default:
+      return REKERNEL_GROUP_NETWORK;
+  }
+}
+// 没有任何接收者时, hook 不再生成事件
+static inline bool rekernel_has_receiver(int group) {
+  if (unlikely(!rekernel_netlink))
+    return false;
+  return rekernel_unicast_alive || __atomic_load_n(&rekernel_mmap_users, __ATOMIC_RELAXED)
+         || netlink_has_listeners(rekernel_netlink, group);
+}
+static bool rekernel_has_group_listeners(void) {
+  if (!rekernel_netlink)
+    return false;
+  for (int group = 1; group <= REKERNEL_GROUP_MAX; group++) {
+    if (netlink_has_listeners(rekernel_netlink, group))
+      return true;
+  }
+  return false;
+}
+static inline void rekernel_prepare_event(struct rekernel_event_buf* evb) {
+  struct rekernel_event* ev = &evb->ev;
+  ev->version = REKERNEL_EVENT_VERSION;
+  size_t payload_size = rekernel_event_payload_size(ev);
+  ev->rpc_name_offset = payload_size ? sizeof(struct rekernel_event) : 0;
+  ev->size = sizeof(struct rekernel_event) + payload_size;
+}
+// 广播给订阅了对应 group 的进程, 总是使用二进制格式
+static void rekernel_multicast_event(struct rekernel_batch* batches, struct rekernel_event_buf* evb) {
+  int group = rekernel_event_group(evb->ev.reporttype, evb->ev.type);
+  if (netlink_has_listeners(rekernel_netlink, group)) {
+    rekernel_batch_add(&batches[group], evb, evb->ev.size, REKERNEL_MSG_EVENT);
+  }
+}
+
+// 优先级, USER_PORT 拥塞时先发送 HIGH, 同步 binder 和 signal 不会因为异步事件被丢弃
+enum rekernel_prio {
+  REKERNEL_PRIO_HIGH,
+  REKERNEL_PRIO_LOW,
+  REKERNEL_PRIO_MAX,
+};
+static inline int rekernel_event_prio(const struct rekernel_event* ev) {
+  if (ev->reporttype == SIGNAL || (ev->reporttype == BINDER && !ev->oneway))
+    return REKERNEL_PRIO_HIGH;
+  return REKERNEL_PRIO_LOW;
+}
+// 缓冲区满或无法发送而丢弃的事件数
+static uint32_t rekernel_dropped[REKERNEL_PRIO_MAX];
+// 接收缓冲区满, 保留事件等待重试
+static inline bool rekernel_unicast_congested(int rc) { return rc == -EAGAIN || rc == -ENOBUFS; }
+
+// 合并窗口, 直接映射, 冲突时覆盖旧的窗口
+struct rekernel_coalesce {
+  uint8_t reporttype;
+  uint8_t type;
+  bool used;
+  uint8_t prio;
+  uint32_t src_uid;
+  uint32_t dst_uid;
+  uint32_t repeat;
+  u64 expires;
+};
+// 单生产者环形缓冲区, hook 关中断写入 head, flush 线程发送成功后推进 tail
+// cursor: 已写入当前 batch 的位置, 拥塞时回滚到 tail
+// sent: 已广播的位置, 重试时不再重复广播
+struct rekernel_queue {
+  uint32_t head;
+  uint32_t tail;
+  uint32_t cursor;
+  uint32_t sent;
+  struct rekernel_event_buf slots[REKERNEL_RING_SIZE];
+};
+// 每个 cpu 按优先级各一个队列
+struct rekernel_ring {
+  struct rekernel_queue queues[REKERNEL_PRIO_MAX];
+  struct rekernel_coalesce coalesce[REKERNEL_COALESCE_SIZE];
+};
+static struct rekernel_ring* rekernel_rings;
+static unsigned int rekernel_nr_rings;
+static struct task_struct* rekernel_flush_task;
+static struct completion rekernel_flush_done;
+// 0 为空闲, 1 为已唤醒, 2 为已结束 batch 等待, 每轮最多 complete 两次
+static int rekernel_flush_pending;
+// 队列中有高优先级事件时不等待 batch deadline
+static int rekernel_flush_urgent;
+// seq 由 flush 线程在首次处理事件时分配, 缓冲区满而丢弃的事件数计入 rekernel_seq_skip, 分配前跳过
+static uint32_t rekernel_seq, rekernel_seq_skip;
+
+static inline struct rekernel_ring* this_cpu_ring(void) {
+  int cpu = *(int*)((uintptr_t)kvar(cpu_number) + rekernel_cpu_offset());
+  if (unlikely(cpu < 0 || cpu >= rekernel_nr_rings))
+    return NULL;
+  return &rekernel_rings[cpu];
+}
+// 唤醒 flush 线程, 已有未处理的唤醒时跳过
+static inline void rekernel_wake_flush(void) {
+  int idle = 0;
+  if (__atomic_compare_exchange_n(&rekernel_flush_pending, &idle, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    complete(&rekernel_flush_done);
+}
+// 唤醒 flush 线程并结束 batch 等待, 本轮已结束过时跳过
+static inline void rekernel_kick_flush(void) {
+  if (__atomic_exchange_n(&rekernel_flush_pending, 2, __ATOMIC_ACQ_REL) != 2)
+    complete(&rekernel_flush_done);
+}
+// 写入当前 cpu 对应优先级的队列
+static void rekernel_queue_event(struct rekernel_event_buf* evb) {
+  if (unlikely(!rekernel_rings))
+    return;
+
+  bool full = false;
+  int prio = rekernel_event_prio(&evb->ev);
+  unsigned long flags = rekernel_irq_save();
+  struct rekernel_ring* ring = this_cpu_ring();
+  if (likely(ring)) {
+    struct rekernel_queue* queue = &ring->queues[prio];
+    uint32_t head = queue->head;
+    uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    if (likely(head - tail < REKERNEL_RING_SIZE)) {
+      rekernel_event_copy(&queue->slots[head & (REKERNEL_RING_SIZE - 1)], evb);
+      __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+      // 积压足够多的事件时提前结束 batch 等待
+      full = (head + 1 - tail == rekernel_batch_events);
+    } else {
+      __atomic_fetch_add(&rekernel_dropped[prio], 1, __ATOMIC_RELAXED);
+      __atomic_fetch_add(&rekernel_seq_skip, 1, __ATOMIC_RELAXED);
+    }
+  }
+  rekernel_irq_restore(flags);
+
+  // 同步 binder 的调用者正在等待, 立即结束 batch 等待
+  if (prio == REKERNEL_PRIO_HIGH) {
+    __atomic_store_n(&rekernel_flush_urgent, 1, __ATOMIC_RELEASE);
+    full = true;
+  }
+  if (full) {
+    rekernel_kick_flush();
+  } else {
+    rekernel_wake_flush();
+  }
+}
+// 窗口内的相同事件只计数, 返回 true 时丢弃
+static bool rekernel_coalesce_event(struct rekernel_event* ev) {
+  u64 window = __atomic_load_n(&rekernel_coalesce_window, __ATOMIC_RELAXED);
+  if (!window || unlikely(!rekernel_rings))
+    return false;
+
+  uint32_t hash = (ev->src_uid * 31 + ev->dst_uid) * 31 + (ev->reporttype << 8 | ev->type);
+  bool suppress = false;
+  uint32_t lost = 0;
+  int lost_prio = 0;
+  u64 now = ev->timestamp;
+  unsigned long flags = rekernel_irq_save();
+  struct rekernel_ring* ring = this_cpu_ring();
+  if (likely(ring)) {
+    struct rekernel_coalesce* entry = &ring->coalesce[hash & (REKERNEL_COALESCE_SIZE - 1)];
+    if (entry->used && entry->reporttype == ev->reporttype && entry->type == ev->type
+        && entry->src_uid == ev->src_uid && entry->dst_uid == ev->dst_uid) {
+      if (now < entry->expires) {
+        entry->repeat++;
+        suppress = true;
+      } else {
+        ev->repeat = entry->repeat;
+        entry->repeat = 0;
+        entry->expires = now + window;
+      }
+    } else if (entry->used && entry->repeat && now < entry->expires) {
+      // 窗口内的其他事件仍有未上报的计数, 不覆盖, 本事件直接发送
+    } else {
+      // 被覆盖的计数无法再随相同的事件上报, 计入丢弃的事件数
+      if (entry->used && entry->repeat) {
+        lost = entry->repeat;
+        lost_prio = entry->prio;
+      }
+      entry->used = true;
+      entry->prio = rekernel_event_prio(ev);
+      entry->reporttype = ev->reporttype;
+      entry->type = ev->type;
+      entry->src_uid = ev->src_uid;
+      entry->dst_uid = ev->dst_uid;
+      entry->repeat = 0;
+      entry->expires = now + window;
+    }
+  }
+  rekernel_irq_restore(flags);
+  if (lost) {
+    __atomic_fetch_add(&rekernel_dropped[lost_prio], lost, __ATOMIC_RELAXED);
+  }
+  return suppress;
+}
+
+// 等待解冻的 uid, 直接映射, 冲突时覆盖, 最多多发送一次事件
+struct rekernel_thaw {
+  uid_t uid;
+  pid_t pid;
+  uint32_t repeat;
+  bool pending;
+};
+static struct rekernel_thaw rekernel_thaw_table[REKERNEL_THAW_SIZE];
+static spinlock_t rekernel_thaw_lock;
+
+static inline struct rekernel_thaw* rekernel_thaw_entry(uid_t uid) {
+  return &rekernel_thaw_table[(uid ^ (uid >> 8)) & (REKERNEL_THAW_SIZE - 1)];
+}
+// 目标已解冻, 清除 pending, 不加锁预检查以减少 binder 热路径的开销
+static inline void rekernel_thaw_clear(uid_t uid) {
+  struct rekernel_thaw* entry = rekernel_thaw_entry(uid);
+  if (likely(!__atomic_load_n(&entry->pending, __ATOMIC_RELAXED) || entry->uid != uid))
+    return;
+
+  unsigned long flags = rekernel_irq_save();
+  spin_lock(&rekernel_thaw_lock);
+  if (entry->uid == uid) {
+    __atomic_store_n(&entry->pending, false, __ATOMIC_RELAXED);
+  }
+  spin_unlock(&rekernel_thaw_lock);
+  rekernel_irq_restore(flags);
+}
+// 目标已上报且未解冻时只计数, 返回 true 时丢弃
+static bool rekernel_thaw_event(struct rekernel_event* ev) {
+  if (!__atomic_load_n(&rekernel_thaw_dedup, __ATOMIC_RELAXED))
+    return false;
+
+  bool suppress = false;
+  struct rekernel_thaw* entry = rekernel_thaw_entry(ev->dst_uid);
+  unsigned long flags = rekernel_irq_save();
+  spin_lock(&rekernel_thaw_lock);
+  if (entry->uid == ev->dst_uid && entry->pending) {
+    entry->repeat++;
+    suppress = true;
+  } else {
+    if (entry->uid == ev->dst_uid) {
+      ev->repeat += entry->repeat;
+    }
+    entry->uid = ev->dst_uid;
+    entry->pid = ev->dst_pid;
+    entry->repeat = 0;
+    __atomic_store_n(&entry->pending, true, __ATOMIC_RELAXED);
+  }
+  spin_unlock(&rekernel_thaw_lock);
+  rekernel_irq_restore(flags);
+  return suppress;
+}
+// 没有新的事件时 hook 无法发现解冻, 由 flush 线程检查
+// PREEMPT_RCU 内核关中断不等于 rcu 读临界区, find_task_by_vpid 返回的 task 只在 rcu_read_lock 内有效
+static void rekernel_thaw_sweep(void) {
+  if (!__atomic_load_n(&rekernel_thaw_dedup, __ATOMIC_RELAXED))
+    return;
+
+  for (int i = 0; i < REKERNEL_THAW_SIZE; i++) {
+    struct rekernel_thaw* entry = &rekernel_thaw_table[i];
+    if (!__atomic_load_n(&entry->pending, __ATOMIC_RELAXED))
+      continue;
+
+    rcu_read_lock();
+    unsigned long flags = rekernel_irq_save();
+    spin_lock(&rekernel_thaw_lock);
+    if (entry->pending) {
+      struct task_struct* task = find_task_by_vpid(entry->pid);
+      if (!task || task_uid(task).val != entry->uid || !frozen_task_group(task)) {
+        __atomic_store_n(&entry->pending, false, __ATOMIC_RELAXED);
+      }
+    }
+    spin_unlock(&rekernel_thaw_lock);
+    rekernel_irq_restore(flags);
+    rcu_read_unlock();
+  }
+}
+// 依次经过合并窗口和等待解冻检查, 返回 true 时丢弃
+static inline bool rekernel_suppress_event(struct rekernel_event* ev) {
+  return rekernel_coalesce_event(ev) || rekernel_thaw_event(ev);
+}
+// 写入 /proc/rekernel/events, 守护进程未及时读取时返回 -EAGAIN
+// tail 由用户态写入, 只用于判断剩余空间
+static int rekernel_mmap_write(struct rekernel_event_buf* evb) {
+  uint32_t head = rekernel_mmap_head;
+  uint32_t tail = __atomic_load_n(&rekernel_mmap->tail, __ATOMIC_ACQUIRE);
+  if (head - tail >= REKERNEL_MMAP_RECORDS)
+    return -EAGAIN;
+
+  char* record = (char*)rekernel_mmap + REKERNEL_MMAP_DATA_OFFSET
+                 + (head % REKERNEL_MMAP_RECORDS) * REKERNEL_MMAP_RECORD_SIZE;
+  memcpy(record, evb, evb->ev.size);
+  rekernel_mmap_head = head + 1;
+  __atomic_store_n(&rekernel_mmap->head, rekernel_mmap_head, __ATOMIC_RELEASE);
+  return 0;
+}
+// 发送成功时推进 tail, 拥塞时回滚 cursor
+static void rekernel_queue_commit(int prio, bool rollback) {
+  for (unsigned int cpu = 0; cpu < rekernel_nr_rings; cpu++) {
+    struct rekernel_queue* queue = &rekernel_rings[cpu].queues[prio];
+    if (rollback) {
+      queue->cursor = queue->tail;
+    } else {
+      __atomic_store_n(&queue->tail, queue->cursor, __ATOMIC_RELEASE);
+    }
+  }
+}
+static int rekernel_unicast_flush(struct rekernel_batch* batch, int prio) {
+  int count = batch->count;
+  int rc = rekernel_batch_flush(batch);
+  if (rc < 0 && !rekernel_unicast_congested(rc)) {
+    __atomic_fetch_add(&rekernel_dropped[prio], count, __ATOMIC_RELAXED);
+  }
+  return rc;
+}
+// 发送一个优先级的所有事件, USER_PORT 拥塞时返回 false
+// 拥塞或 unicast 为 false 时只广播, 未发送给 USER_PORT 的事件留在队列中, 多播订阅者不受影响
+static bool rekernel_flush_prio(struct rekernel_batch* batches, int prio, bool deliver, bool unicast) {
+  bool mapped = __atomic_load_n(&rekernel_mmap_users, __ATOMIC_ACQUIRE);
+  bool binary = rekernel_format == REKERNEL_FORMAT_BINARY;
+  bool congested = !unicast;
+  unicast = deliver && rekernel_unicast_alive && !mapped;
+  for (unsigned int cpu = 0; cpu < rekernel_nr_rings; cpu++) {
+    struct rekernel_queue* queue = &rekernel_rings[cpu].queues[prio];
+    uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    if (!deliver) {
+      queue->cursor = head;
+      continue;
+    }
+    if (!congested) {
+      queue->cursor = queue->tail;
+    }
+    for (uint32_t pos = queue->tail; pos != head; pos++) {
+      struct rekernel_event_buf* evb = &queue->slots[pos & (REKERNEL_RING_SIZE - 1)];
+      rekernel_prepare_event(evb);
+      if ((int32_t)(pos - queue->sent) >= 0) {
+        evb->ev.seq = ++rekernel_seq;
+        rekernel_ack_record(evb->ev.seq, evb->ev.timestamp);
+        rekernel_multicast_event(batches, evb);
+        queue->sent = pos + 1;
+      }
+      if (congested)
+        continue;
+      if (mapped) {
+        if (rekernel_mmap_write(evb) < 0) {
+          rekernel_queue_commit(prio, true);
+          congested = true;
+          continue;
+        }
+        queue->cursor = pos + 1;
+        __atomic_store_n(&queue->tail, pos + 1, __ATOMIC_RELEASE);
+        continue;
+      }
+      if (!unicast) {
+        queue->cursor = pos + 1;
+        continue;
+      }
+
+      int rc;
+      if (binary) {
+        // batch 放不下时先发送, 之前的事件已经发送或无法重试
+        if (!rekernel_batch_room(&batches[0], evb->ev.size)) {
+          rc = rekernel_unicast_flush(&batches[0], prio);
+          if (rekernel_unicast_congested(rc)) {
+            rekernel_queue_commit(prio, true);
+            congested = true;
+            continue;
+          }
+          rekernel_queue_commit(prio, false);
+        }
+        rc = rekernel_batch_add(&batches[0], evb, evb->ev.size, REKERNEL_MSG_EVENT);
+        if (rc < 0) {
+          __atomic_fetch_add(&rekernel_dropped[prio], 1, __ATOMIC_RELAXED);
+        }
+        queue->cursor = pos + 1;
+      } else {
+        char binder_kmsg[PACKET_SIZE];
+        rekernel_event_to_text(evb, binder_kmsg, sizeof(binder_kmsg));
+        rc = send_netlink_message(binder_kmsg);
+        if (rekernel_unicast_congested(rc)) {
+          rekernel_queue_commit(prio, true);
+          congested = true;
+          continue;
+        }
+        if (rc < 0) {
+          __atomic_fetch_add(&rekernel_dropped[prio], 1, __ATOMIC_RELAXED);
+        }
+        queue->cursor = pos + 1;
+        __atomic_store_n(&queue->tail, pos + 1, __ATOMIC_RELEASE);
+      }
+    }
+  }
+
+  if (congested)
+    return false;
+  if (rekernel_unicast_congested(rekernel_unicast_flush(&batches[0], prio))) {
+    rekernel_queue_commit(prio, true);
+    return false;
+  }
+  rekernel_queue_commit(prio, false);
+  return true;
+}
+// USER_PORT 恢复接收后发送丢弃的事件数
+static void rekernel_report_dropped(void) {
+  bool mapped = __atomic_load_n(&rekernel_mmap_users, __ATOMIC_ACQUIRE);
+  if (!rekernel_unicast_alive && !mapped)
+    return;
+
+  struct rekernel_dropped dropped = {
+      .high = __atomic_exchange_n(&rekernel_dropped[REKERNEL_PRIO_HIGH], 0, __ATOMIC_RELAXED),
+      .low = __atomic_exchange_n(&rekernel_dropped[REKERNEL_PRIO_LOW], 0, __ATOMIC_RELAXED),
+  };
+  if (!dropped.high && !dropped.low)
+    return;
+
+  int rc;
+  if (mapped) {
+    __atomic_fetch_add(&rekernel_mmap->dropped_high, dropped.high, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&rekernel_mmap->dropped_low, dropped.low, __ATOMIC_RELAXED);
+    rc = 0;
+  } else if (rekernel_format == REKERNEL_FORMAT_BINARY) {
+    rc = send_netlink_data(&dropped, sizeof(dropped), REKERNEL_MSG_DROPPED, USER_PORT);
+  } else {
+    char binder_kmsg[PACKET_SIZE];
+    snprintf(binder_kmsg, sizeof(binder_kmsg), "type=Dropped,high=%d,low=%d;", dropped.high, dropped.low);
+    rc = send_netlink_message(binder_kmsg);
+  }
+  // 发送失败时累加到下一次
+  if (rc < 0) {
+    __atomic_fetch_add(&rekernel_dropped[REKERNEL_PRIO_HIGH], dropped.high, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&rekernel_dropped[REKERNEL_PRIO_LOW], dropped.low, __ATOMIC_RELAXED);
+  }
+#ifdef CONFIG_DEBUG
+  logkm("dropped high=%d,low=%d,rc=%d\n", dropped.high, dropped.low, rc);
+#endif /* CONFIG_DEBUG */
+}
+// 取出所有 cpu 的事件并发送, USER_PORT 拥塞时返回 false, 低优先级的事件留在队列中等待 USER_PORT, 但仍然广播
+static bool rekernel_flush_rings(bool deliver) {
+  struct rekernel_batch batches[REKERNEL_GROUP_MAX + 1] = {};
+  for (int group = 0; group <= REKERNEL_GROUP_MAX; group++) {
+    batches[group].group = group;
+  }
+  rekernel_seq += __atomic_exchange_n(&rekernel_seq_skip, 0, __ATOMIC_RELAXED);
+  bool drained = true;
+  for (int prio = 0; prio < REKERNEL_PRIO_MAX; prio++) {
+    drained = rekernel_flush_prio(batches, prio, deliver, drained) && drained;
+  }
+  for (int group = 1; group <= REKERNEL_GROUP_MAX; group++) {
+    rekernel_batch_flush(&batches[group]);
+  }
+  if (drained && deliver) {
+    rekernel_report_dropped();
+  }
+  if (rekernel_mmap && rekernel_mmap_woken != rekernel_mmap_head) {
+    rekernel_mmap_woken = rekernel_mmap_head;
+    wake_up(&rekernel_mmap_wait);
+  }
+  return drained;
+}
+
+static void binder_sweep_frozen(void);
+#ifdef CONFIG_NETWORK
+static void network_window_flush(void);
+#endif /* CONFIG_NETWORK */
+
+static int rekernel_flush_thread(void* data) {
+  bool drained = true;
+  while (!kthread_should_stop()) {
+    // 服务创建失败时丢弃事件
+    bool deliver = start_rekernel_server() == 0;
+    // 拥塞时定时重试
+    long woken = wait_for_completion_interruptible_timeout(
+        &rekernel_flush_done, msecs_to_jiffies(drained ? REKERNEL_FLUSH_INTERVAL : REKERNEL_CONGESTED_INTERVAL));
+    // 等待更多事件合并发送, 期间 rekernel_wake_flush 不会重复唤醒, 只有低优先级事件时才等待
+    if (woken > 0 && rekernel_batch_deadline && !__atomic_load_n(&rekernel_flush_urgent, __ATOMIC_ACQUIRE)
+        && (rekernel_format == REKERNEL_FORMAT_BINARY || rekernel_has_group_listeners())) {
+      wait_for_completion_interruptible_timeout(&rekernel_flush_done, msecs_to_jiffies(rekernel_batch_deadline));
+    }
+    // 丢弃本轮多余的 complete, 之后的唤醒由本轮 flush 覆盖或进入下一轮
+    reinit_completion(&rekernel_flush_done);
+    __atomic_store_n(&rekernel_flush_urgent, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&rekernel_flush_pending, 0, __ATOMIC_RELEASE);
+    drained = rekernel_flush_rings(deliver);
+    rekernel_thaw_sweep();
+    binder_sweep_frozen();
+#ifdef CONFIG_NETWORK
+    network_window_flush();
+#endif /* CONFIG_NETWORK */
+  }
+  return 0;
+}
+
+static int start_rekernel_flush(void) {
+  rekernel_nr_rings = *kvar(nr_cpu_ids);
+  rekernel_rings = vzalloc(sizeof(struct rekernel_ring) * rekernel_nr_rings);
+  if (!rekernel_rings)
+    return -ENOMEM;
+
+  init_completion(&rekernel_flush_done);
+  rekernel_flush_task = kthread_create(rekernel_flush_thread, NULL, "rekernel_flush");
+  if (IS_ERR(rekernel_flush_task) || !rekernel_flush_task) {
+    rekernel_flush_task = NULL;
+    vfree(rekernel_rings);
+    rekernel_rings = NULL;
+    return -ENOMEM;
+  }
+  kfunc(wake_up_process)(rekernel_flush_task);
+  return 0;
+}
+
+static void stop_rekernel_flush(void) {
+  if (rekernel_flush_task) {
+    complete(&rekernel_flush_done);
+    kthread_stop(rekernel_flush_task);
+    rekernel_flush_task = NULL;
+  }
+  if (rekernel_rings) {
+    rekernel_flush_rings(rekernel_netlink != NULL);
+    vfree(rekernel_rings);
+    rekernel_rings = NULL;
+  }
+}
+
+static inline u32 parcel_read_u32(const char* data, size_t offset) {
+  u32 val;
+  memcpy(&val, data + offset, sizeof(val));
+  return val;
+}
+
+// offset 处是否为合理的 String16 长度, 且第一个字符为 ASCII
+static bool parcel_string_valid(const char* data, size_t size, size_t offset) {
+  if (offset + 6 > size)
+    return false;
+  u32 len = parcel_read_u32(data, offset);
+  if (len == 0 || len > PARCEL_STRING_MAX)
+    return false;
+  return data[offset + 4] > 0x20 && data[offset + 4] < 0x7f && data[offset + 5] == 0;
+}
+
+// 查找 interface token 长度字段的位置
+// Android 11+: strict mode, work source, kHeader
+// Android 10: strict mode, work source
+// Android 9-: strict mode
+static int parcel_interface_token_offset(const char* data, size_t size) {
+  if (size >= PARCEL_OFFSET) {
+    u32 header = parcel_read_u32(data, 8);
+    if (header == PARCEL_HEADER_SYST || header == PARCEL_HEADER_VNDR || header == PARCEL_HEADER_RECO)
+      return 12;
+  }
+  if (parcel_string_valid(data, size, 8))
+    return 8;
+  if (parcel_string_valid(data, size, 4))
+    return 4;
+  return -1;
+}
+
+// UTF-16 转 ASCII, 每次处理 4 个字符, 遇到 '\0' 结束, 非 ASCII 字符替换为 '?'
+static size_t parcel_narrow_utf16(const char* src, size_t count, char* dst) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    u64 v;
+    memcpy(&v, src + i * 2, sizeof(v));
+    // 含有非 ASCII 或 '\0' 时交给逐字符处理
+    if ((v & 0xff80ff80ff80ff80ULL) || ((v - 0x0001000100010001ULL) & ~v & 0x8000800080008000ULL))
+      break;
+    v = (v | (v >> 8)) & 0x0000ffff0000ffffULL;
+    v = (v | (v >> 16)) & 0x00000000ffffffffULL;
+    u32 packed = (u32)v;
+    memcpy(dst + i, &packed, sizeof(packed));
+  }
+  for (; i < count; i++) {
+    u16 c;
+    memcpy(&c, src + i * 2, sizeof(c));
+    if (c == 0)
+      break;
+    dst[i] = c < 0x80 ? (char)c : '?';
+  }
+  return i;
+}
+
+// 从 Parcel 头部解析 interface token 的位置和需要读取的字符数, size 为 Parcel 的总长度
+static size_t parcel_interface_token_count(const char* head, size_t head_size, size_t size, size_t* offset) {
+  int pos = parcel_interface_token_offset(head, head_size);
+  if (pos < 0 || pos + 4 > head_size)
+    return 0;
+  u32 len = parcel_read_u32(head, pos);
+  // 空字符串长度为 -1
+  if (len == 0 || len == 0xffffffff)
+    return 0;
+  size_t count = (size - pos - 4) / 2;
+  if (count > len)
+    count = len;
+  if (count > INTERFACETOKEN_BUFF_SIZE - 1)
+    count = INTERFACETOKEN_BUFF_SIZE - 1;
+  *offset = pos + 4;
+  return count;
+}
+
+// 从 Parcel 头部解析 interface token, 返回长度
+static size_t binder_parse_interface_token(const char* data, size_t size, char* buf) {
+  size_t offset = 0;
+  size_t count = parcel_interface_token_count(data, size, size, &offset);
+  count = parcel_narrow_utf16(data + offset, count, buf);
+  buf[count] = '\0';
+  return count;
+}
+
+// 从目标进程的 binder_buffer 分段读取 interface token, 偏移保持 4 字节对齐
+static bool binder_copy_interface_token(struct binder_alloc* alloc, struct binder_buffer* buffer, char* buf) {
+  char head[INTERFACETOKEN_HEAD_SIZE];
+  size_t head_size = buffer->data_size > INTERFACETOKEN_HEAD_SIZE ? INTERFACETOKEN_HEAD_SIZE : buffer->data_size;
+  if (binder_alloc_copy_from_buffer(alloc, head, buffer, 0, head_size))
+    return false;
+  size_t offset = 0;
+  size_t count = parcel_interface_token_count(head, head_size, buffer->data_size, &offset);
+  size_t done = 0;
+  char chunk[INTERFACETOKEN_CHUNK * 2];
+  while (done < count) {
+    size_t n = count - done > INTERFACETOKEN_CHUNK ? INTERFACETOKEN_CHUNK : count - done;
+    if (binder_alloc_copy_from_buffer(alloc, chunk, buffer, offset + done * 2, n * 2))
+      break;
+    size_t narrowed = parcel_narrow_utf16(chunk, n, buf + done);
+    done += narrowed;
+    if (narrowed < n)
+      break;
+  }
+  buf[done] = '\0';
+  return true;
+}
+// t 不为空时从已复制到目标进程的 binder_buffer 读取, 否则从发送者的用户空间复制
+static bool binder_read_interface_token(struct binder_transaction* t, struct binder_transaction_data* tr, char* buf) {
+  if (!tr) {
+    struct binder_buffer* buffer = binder_transaction_buffer(t);
+    struct binder_proc* to_proc = binder_transaction_to_proc(t);
+    if (!buffer || !to_proc)
+      return false;
+    return binder_copy_interface_token(binder_proc_alloc(to_proc), buffer, buf);
+  }
+
+  size_t buf_data_size = tr->data_size > INTERFACETOKEN_DATA_SIZE ? INTERFACETOKEN_DATA_SIZE : tr->data_size;
+  char* buf_data = memdup_user((char*)tr->data.ptr.buffer, buf_data_size);
+  if (IS_ERR(buf_data))
+    return false;
+  binder_parse_interface_token(buf_data, buf_data_size, buf);
+  kvfree(buf_data);
+  return true;
+}
+
+// rpc_name 缓存, 以 (目标进程, node ptr, cookie) 为键, debug_id 用于识别复用的 binder_node
+struct rpc_name_entry {
+  struct binder_proc* proc;
+  struct binder_node* node;
+  int debug_id;
+  binder_uintptr_t ptr;
+  binder_uintptr_t cookie;
+  char name[INTERFACETOKEN_BUFF_SIZE];
+};
+struct rpc_name_set {
+  u32 victim;
+  struct rpc_name_entry ways[RPC_NAME_CACHE_WAYS];
+};
+static struct rpc_name_set* rpc_name_cache;
+static spinlock_t rpc_name_cache_lock;
+
+static inline struct rpc_name_set* rpc_name_cache_set(struct binder_proc* proc, binder_uintptr_t ptr,
+                                                      binder_uintptr_t cookie) {
+  u64 hash = (uintptr_t)proc;
+  hash = hash * 31 + ptr;
+  hash = hash * 31 + cookie;
+  hash ^= hash >> 32;
+  hash ^= hash >> 16;
+  return &rpc_name_cache[hash & (RPC_NAME_CACHE_SETS - 1)];
+}
+
+static inline bool rpc_name_entry_match(struct rpc_name_entry* e, struct binder_proc* proc, struct binder_node* node,
+                                        binder_uintptr_t ptr, binder_uintptr_t cookie) {
+  return e->node == node && e->debug_id == node->debug_id && e->proc == proc && e->ptr == ptr && e->cookie == cookie;
+}
+
+// 返回 t 的目标 binder_node, 缓存不可用时返回 NULL
+// trace 时 binder_buffer 尚未分配, 使用 tracepoint 传入的 target_node
+static struct binder_node* rpc_name_cache_node(struct binder_transaction* t, struct binder_node* target_node,
+                                               struct binder_proc** proc) {
+  if (!rpc_name_cache || !t)
+    return NULL;
+  struct binder_buffer* buffer = binder_transaction_buffer(t);
+  *proc = binder_transaction_to_proc(t);
+  if (!*proc)
+    return NULL;
+  return buffer ? buffer->target_node : target_node;
+}
+
+static bool rpc_name_cache_get(struct binder_transaction* t, struct binder_node* target_node, char* buf) {
+  struct binder_proc* proc;
+  struct binder_node* node = rpc_name_cache_node(t, target_node, &proc);
+  if (!node)
+    return false;
+  binder_uintptr_t ptr = binder_node_ptr(node);
+  binder_uintptr_t cookie = binder_node_cookie(node);
+  struct rpc_name_set* set = rpc_name_cache_set(proc, ptr, cookie);
+  bool hit = false;
+
+  spin_lock(&rpc_name_cache_lock);
+  for (int i = 0; i < RPC_NAME_CACHE_WAYS; i++) {
+    struct rpc_name_entry* e = &set->ways[i];
+    if (rpc_name_entry_match(e, proc, node, ptr, cookie)) {
+      memcpy(buf, e->name, INTERFACETOKEN_BUFF_SIZE);
+      hit = true;
+      break;
+    }
+  }
+  spin_unlock(&rpc_name_cache_lock);
+  return hit;
+}
+
+static void rpc_name_cache_put(struct binder_transaction* t, struct binder_node* target_node, const char* name) {
+  struct binder_proc* proc;
+  struct binder_node* node = rpc_name_cache_node(t, target_node, &proc);
+  if (!node || name[0] == '\0')
+    return;
+  binder_uintptr_t ptr = binder_node_ptr(node);
+  binder_uintptr_t cookie = binder_node_cookie(node);
+  struct rpc_name_set* set = rpc_name_cache_set(proc, ptr, cookie);
+
+  spin_lock(&rpc_name_cache_lock);
+  struct rpc_name_entry* e = NULL;
+  for (int i = 0; i < RPC_NAME_CACHE_WAYS; i++) {
+    if (rpc_name_entry_match(&set->ways[i], proc, node, ptr, cookie) || !set->ways[i].node) {
+      e = &set->ways[i];
+      break;
+    }
+  }
+  // 组已满时轮流替换
+  if (!e) {
+    e = &set->ways[set->victim];
+    set->victim = (set->victim + 1) % RPC_NAME_CACHE_WAYS;
+  }
+  e->proc = proc;
+  e->node = node;
+  e->debug_id = node->debug_id;
+  e->ptr = ptr;
+  e->cookie = cookie;
+  memcpy(e->name, name, INTERFACETOKEN_BUFF_SIZE);
+  spin_unlock(&rpc_name_cache_lock);
+}
+
+static void binder_free_node_before(hook_fargs1_t* args, void* udata) {
+  struct binder_node* node = (struct binder_node*)args->arg0;
+  if (!rpc_name_cache)
+    return;
+  struct rekernel_hook_slot* slot = rekernel_hook_enter();
+  if (!slot)
+    return;
+
+  spin_lock(&rpc_name_cache_lock);
+  for (int i = 0; i < RPC_NAME_CACHE_SETS; i++) {
+    for (int j = 0; j < RPC_NAME_CACHE_WAYS; j++) {
+      struct rpc_name_entry* e = &rpc_name_cache[i].ways[j];
+      if (e->node == node) {
+        memset(e, 0, sizeof(*e));
+      }
+    }
+  }
+  spin_unlock(&rpc_name_cache_lock);
+  rekernel_hook_exit(slot);
+}
+
+// binder_transaction_before 记录的当前线程的 binder_transaction_data
+static inline struct binder_transaction_data* binder_current_tr(void) {
+  if (ext_tr_offset == UZERO)
+    return NULL;
+  struct task_ext* ext = get_task_ext(current);
+  return *(void**)task_local_ptr(ext, ext_tr_offset);
+}
+// 先查找缓存, 未命中时读取 interface token 并缓存
+static bool binder_rpc_name(struct binder_transaction* t, struct binder_node* target_node,
+                            struct binder_transaction_data* tr, char* buf) {
+  if (rpc_name_cache_get(t, target_node, buf))
+    return true;
+  if (!binder_read_interface_token(t, tr, buf))
+    return false;
+  rpc_name_cache_put(t, target_node, buf);
+  return true;
+}
+
+static void rekernel_report(int reporttype, int type, const struct rekernel_task* src, const struct rekernel_task* dst,
+                            bool oneway, struct binder_transaction* t, const void* payload) {
+  if (!rekernel_filter_match_type(reporttype, type))
+    return;
+  if (!rekernel_has_receiver(rekernel_event_group(reporttype, type)))
+    return;
+
+  struct rekernel_event_buf evb = {
+      .ev = {
+          .timestamp = ktime_get_mono_fast_ns(),
+          .reporttype = reporttype,
+          .type = type,
+          .oneway = oneway,
+      },
+  };
+#ifdef CONFIG_NETWORK
+  if (reporttype == NETWORK) {
+    if (!rekernel_filter_match_uid(dst->uid))
+      return;
+    evb.ev.dst_uid = dst->uid;
+    // 已按 uid 在窗口内汇总, 不再合并, 否则丢失 packets 和 bytes
+    if (payload) {
+      evb.network = *(const struct rekernel_network*)payload;
+    }
+#ifdef CONFIG_DEBUG
+    char binder_kmsg[PACKET_SIZE];
+    rekernel_event_to_text(&evb, binder_kmsg, sizeof(binder_kmsg));
+    logkm("%s\n", binder_kmsg);
+#endif /* CONFIG_DEBUG */
+    rekernel_queue_event(&evb);
+    return;
+  }
+#endif /* CONFIG_NETWORK */
+
+  if (!rekernel_filter_match_uid(dst->uid))
+    return;
+  if (src->uid == dst->uid)
+    return;
+
+  if (!frozen_task_group(dst->task)) {
+    rekernel_thaw_clear(dst->uid);
+    return;
+  }
+
+  evb.ev.src_pid = src->tgid;
+  evb.ev.src_uid = src->uid;
+  evb.ev.dst_pid = dst->tgid;
+  evb.ev.dst_uid = dst->uid;
+  switch (reporttype) {
+    case BINDER:
+      if (oneway && type == TRANSACTION) {
+        struct binder_transaction_data* tr = NULL;
+        if (t && binder_alloc_copy_from_buffer) {
+          evb.ev.code = binder_transaction_code(t);
+        } else {
+          tr = binder_current_tr();
+          if (!tr)
+            return;
+          evb.ev.code = tr->code;
+        }
+        // 减少异步消息
+        if (!rekernel_filter_match_code(evb.ev.code))
+          return;
+        if (rekernel_suppress_event(&evb.ev))
+          return;
+
+        // TRANSACTION 的 payload 为 trace 传入的 target_node
+        if (!binder_rpc_name(t, (struct binder_node*)payload, tr, evb.rpc_name))
+          return;
+        evb.ev.rpc_name_len = strlen(evb.rpc_name);
+      } else if (rekernel_suppress_event(&evb.ev)) {
+        return;
+      } else if (type == OVERFLOW && payload) {
+        evb.overflow = *(const struct rekernel_overflow*)payload;
+      } else if (type == BUDGET && payload) {
+        evb.budget = *(const struct rekernel_budget*)payload;
+      }
+      break;
+    case SIGNAL:
+      if (rekernel_suppress_event(&evb.ev))
+        return;
+      break;
+    default:
+      return;
   }
 #ifdef CONFIG_DEBUG
+  char binder_kmsg[PACKET_SIZE];
+  rekernel_event_to_text(&evb, binder_kmsg, sizeof(binder_kmsg));
   logkm("%s\n", binder_kmsg);
-  logkm("src_comm=%s,dst_comm=%s\n", get_task_comm(src), get_task_comm(dst));
+  logkm("src_comm=%s,dst_comm=%s\n", src->comm, dst->comm);
 #endif /* CONFIG_DEBUG */
 #ifdef CONFIG_DEBUG_CMDLINE
   char src_cmdline[PATH_MAX], dst_cmdline[PATH_MAX];
   memset(&src_cmdline, 0, PATH_MAX);
   memset(&dst_cmdline, 0, PATH_MAX);
   int res = 0;
-  res = get_cmdline(src, src_cmdline, PATH_MAX - 1);
+  res = get_cmdline(src->task, src_cmdline, PATH_MAX - 1);
   src_cmdline[res] = '\0';
-  res = get_cmdline(dst, dst_cmdline, PATH_MAX - 1);
+  res = get_cmdline(dst->task, dst_cmdline, PATH_MAX - 1);
   dst_cmdline[res] = '\0';
   logkm("src_cmdline=%s,dst_cmdline=%s\n", src_cmdline, dst_cmdline);
 #endif /* CONFIG_DEBUG_CMDLINE */
-  send_netlink_message(binder_kmsg);
+  rekernel_queue_event(&evb);
 }
 
-static void binder_reply_handler(pid_t src_pid, struct task_struct* src, pid_t dst_pid, struct task_struct* dst,
-                                 bool oneway) {
+static void binder_reply_handler(struct task_struct* src, struct task_struct* dst, bool oneway) {
   if (unlikely(!dst))
     return;
-  if (task_uid(dst).val > MAX_SYSTEM_UID || src_pid == dst_pid)
+  struct rekernel_task dst_snap, src_snap;
+  rekernel_task_snapshot(&dst_snap, dst);
+  if (dst_snap.uid > MAX_SYSTEM_UID)
+    return;
+  rekernel_task_snapshot(&src_snap, src);
+  if (src_snap.tgid == dst_snap.tgid)
     return;
 
   // oneway=0
-  rekernel_report(BINDER, REPLY, src_pid, src, dst_pid, dst, oneway);
+  rekernel_report(BINDER, REPLY, &src_snap, &dst_snap, oneway, NULL, NULL);
 }
 
-static void binder_trans_handler(pid_t src_pid, struct task_struct* src, pid_t dst_pid, struct task_struct* dst,
-                                 bool oneway) {
+static void binder_trans_handler(struct task_struct* src, struct task_struct* dst, bool oneway,
+                                 struct binder_transaction* t, struct binder_node* target_node) {
   if (unlikely(!dst))
     return;
-  if ((task_uid(dst).val <= MIN_USERAPP_UID) || src_pid == dst_pid)
+  struct rekernel_task dst_snap, src_snap;
+  rekernel_task_snapshot(&dst_snap, dst);
+  if (dst_snap.uid <= MIN_USERAPP_UID)
+    return;
+  rekernel_task_snapshot(&src_snap, src);
+  if (src_snap.tgid == dst_snap.tgid)
     return;
 
-  rekernel_report(BINDER, TRANSACTION, src_pid, src, dst_pid, dst, oneway);
+  rekernel_report(BINDER, TRANSACTION, &src_snap, &dst_snap, oneway, t, target_node);
 }
 
-static void binder_overflow_handler(pid_t src_pid, struct task_struct* src, pid_t dst_pid, struct task_struct* dst,
-                                    bool oneway) {
+static void binder_overflow_handler(struct task_struct* src, struct task_struct* dst, bool oneway,
+                                    const struct rekernel_overflow* overflow) {
   if (unlikely(!dst))
     return;
+  struct rekernel_task dst_snap, src_snap;
+  rekernel_task_snapshot(&dst_snap, dst);
+  rekernel_task_snapshot(&src_snap, src);
 
   // oneway=1
-  rekernel_report(BINDER, OVERFLOW, src_pid, src, dst_pid, dst, oneway);
+  rekernel_report(BINDER, OVERFLOW, &src_snap, &dst_snap, oneway, NULL, overflow);
+}
+
+static void binder_budget_handler(struct task_struct* src, struct task_struct* dst,
+                                  const struct rekernel_budget* budget) {
+  if (unlikely(!dst))
+    return;
+  struct rekernel_task dst_snap, src_snap;
+  rekernel_task_snapshot(&dst_snap, dst);
+  rekernel_task_snapshot(&src_snap, src);
+
+  // oneway=1
+  rekernel_report(BINDER, BUDGET, &src_snap, &dst_snap, true, NULL, budget);
 }
 
 static void rekernel_binder_transaction(void* data, bool reply, struct binder_transaction* t,
@@ -382,74 +2279,535 @@ static void rekernel_binder_transaction(void* data, bool reply, struct binder_tr
   struct binder_proc* to_proc = binder_transaction_to_proc(t);
   if (!to_proc)
     return;
+  struct rekernel_hook_slot* slot = rekernel_hook_enter();
+  if (!slot)
+    return;
   struct binder_thread* from = binder_transaction_from(t);
 
   if (reply) {
-    binder_reply_handler(task_tgid_nr(current), current, to_proc->pid, to_proc->tsk, false);
+    binder_reply_handler(current, to_proc->tsk, false);
   } else if (from) {
     if (from->proc) {
-      binder_trans_handler(from->proc->pid, from->proc->tsk, to_proc->pid, to_proc->tsk, false);
+      binder_trans_handler(from->proc->tsk, to_proc->tsk, false, t, target_node);
     }
   } else {  // oneway=1
-    binder_trans_handler(task_tgid_nr(current), current, to_proc->pid, to_proc->tsk, true);
+    // trace 时 binder_buffer 尚未分配, 由 binder_proc_transaction 上报
+    if (!binder_alloc_copy_from_buffer || binder_transaction_buffer(t)) {
+      binder_trans_handler(current, to_proc->tsk, true, t, target_node);
+    }
+  }
+  rekernel_hook_exit(slot);
+}
+
+// 异步空间压力, 只跟踪低于 exit 的冻结进程, 按目标进程记录消耗速度和占用最多的发送者
+// 低于 enter 时上报一次, 恢复到 exit 以上后才会再次上报
+// 每个条目有自己的锁, 空间充足时不加锁, 处于 low 状态的条目不会被替换, 除非超过 ASYNC_PRESSURE_STALE_NS 没有更新
+struct async_pressure {
+  spinlock_t lock;
+  struct binder_proc* proc;
+  pid_t pid;
+  bool low;
+  size_t last_free;
+  u64 last_ns;
+  s64 rate;
+  u16 nr_senders;
+  struct rekernel_overflow_sender senders[REKERNEL_OVERFLOW_TOP];
+};
+static struct async_pressure async_pressure_table[ASYNC_PRESSURE_SIZE];
+// 处于 low 状态的条目数, 为 0 时空间充足的事务不查找
+static int async_pressure_nr_low;
+
+static inline struct async_pressure* async_pressure_slot(struct binder_proc* proc, int i) {
+  unsigned int start = ((uintptr_t)proc >> 6) & (ASYNC_PRESSURE_SIZE - 1);
+  return &async_pressure_table[(start + i) & (ASYNC_PRESSURE_SIZE - 1)];
+}
+
+static inline void async_pressure_set_low(struct async_pressure* entry, bool low) {
+  if (entry->low != low) {
+    entry->low = low;
+    __atomic_fetch_add(&async_pressure_nr_low, low ? 1 : -1, __ATOMIC_RELAXED);
+  }
+}
+
+// 返回已加锁的条目, 没有可用的条目时返回 NULL
+static struct async_pressure* async_pressure_get(struct binder_proc* proc, u64 now) {
+  for (int i = 0; i < ASYNC_PRESSURE_PROBE; i++) {
+    struct async_pressure* entry = async_pressure_slot(proc, i);
+    if (__atomic_load_n(&entry->proc, __ATOMIC_RELAXED) != proc)
+      continue;
+    spin_lock(&entry->lock);
+    if (entry->proc == proc && entry->pid == proc->pid)
+      return entry;
+    spin_unlock(&entry->lock);
+  }
+  for (int i = 0; i < ASYNC_PRESSURE_PROBE; i++) {
+    struct async_pressure* entry = async_pressure_slot(proc, i);
+    spin_lock(&entry->lock);
+    // 其他 cpu 已经创建了条目
+    if (entry->proc == proc && entry->pid == proc->pid)
+      return entry;
+    if (!entry->proc || !entry->low || now - entry->last_ns > ASYNC_PRESSURE_STALE_NS
+        || (entry->proc == proc && entry->pid != proc->pid)) {
+      async_pressure_set_low(entry, false);
+      __atomic_store_n(&entry->proc, proc, __ATOMIC_RELAXED);
+      entry->pid = proc->pid;
+      entry->last_free = 0;
+      entry->last_ns = 0;
+      entry->rate = 0;
+      entry->nr_senders = 0;
+      return entry;
+    }
+    spin_unlock(&entry->lock);
+  }
+  return NULL;
+}
+
+// 空间恢复到 exit 以上, 清除 low 状态
+static inline void async_pressure_recover(struct binder_proc* proc) {
+  if (likely(!__atomic_load_n(&async_pressure_nr_low, __ATOMIC_RELAXED)))
+    return;
+  for (int i = 0; i < ASYNC_PRESSURE_PROBE; i++) {
+    struct async_pressure* entry = async_pressure_slot(proc, i);
+    if (__atomic_load_n(&entry->proc, __ATOMIC_RELAXED) != proc)
+      continue;
+    unsigned long flags = rekernel_irq_save();
+    spin_lock(&entry->lock);
+    if (entry->proc == proc && entry->low) {
+      async_pressure_set_low(entry, false);
+      entry->nr_senders = 0;
+    }
+    spin_unlock(&entry->lock);
+    rekernel_irq_restore(flags);
+  }
+}
+
+// Space-Saving: 表满时替换占用最少的发送者
+static void async_pressure_account(struct async_pressure* entry, uid_t uid, u32 bytes) {
+  int min = 0;
+  for (int i = 0; i < entry->nr_senders; i++) {
+    if (entry->senders[i].uid == uid) {
+      entry->senders[i].bytes += bytes;
+      return;
+    }
+    if (entry->senders[i].bytes < entry->senders[min].bytes)
+      min = i;
+  }
+  if (entry->nr_senders < REKERNEL_OVERFLOW_TOP) {
+    min = entry->nr_senders++;
+    entry->senders[min].bytes = 0;
+  }
+  entry->senders[min].uid = uid;
+  entry->senders[min].bytes += bytes;
+}
+
+// 返回 true 时 overflow 为需要上报的内容
+static bool binder_async_pressure(struct binder_transaction* t, struct binder_proc* proc,
+                                  struct rekernel_overflow* overflow) {
+  struct binder_alloc* target_alloc = binder_proc_alloc(proc);
+  size_t free_async_space = binder_alloc_free_async_space(target_alloc);
+  size_t buffer_size = binder_alloc_buffer_size(target_alloc);
+  size_t enter_size = buffer_size / 10 + 0x300;
+  size_t exit_size = enter_size + buffer_size / 20;
+  if (likely(free_async_space >= exit_size)) {
+    async_pressure_recover(proc);
+    return false;
+  }
+  // 只有冻结的目标会被上报
+  if (!binder_is_frozen(proc) && !frozen_task_group(proc->tsk))
+    return false;
+
+  struct binder_buffer* buffer = binder_transaction_buffer(t);
+  uid_t uid = task_uid(current).val;
+  u64 now = ktime_get_mono_fast_ns();
+  bool report = false;
+
+  unsigned long flags = rekernel_irq_save();
+  struct async_pressure* entry = async_pressure_get(proc, now);
+  if (!entry) {
+    rekernel_irq_restore(flags);
+    return false;
+  }
+  if (entry->last_ns && now > entry->last_ns) {
+    // 正数为消耗, 负数为释放, 平滑系数 1/8
+    s64 sample = ((s64)entry->last_free - (s64)free_async_space) * 1000000000LL / (s64)(now - entry->last_ns);
+    entry->rate += (sample - entry->rate) / 8;
+  }
+  entry->last_free = free_async_space;
+  entry->last_ns = now;
+  if (buffer) {
+    async_pressure_account(entry, uid, buffer->data_size + buffer->offsets_size + buffer->extra_buffers_size);
+  }
+
+  if (!entry->low && free_async_space < enter_size) {
+    async_pressure_set_low(entry, true);
+    report = true;
+    overflow->free_async_space = free_async_space;
+    overflow->buffer_size = buffer_size;
+    s64 rate = entry->rate;
+    overflow->rate = rate > 0x7fffffff ? 0x7fffffff : (rate < -0x7fffffff ? -0x7fffffff : rate);
+    u64 exhaust_ms = entry->rate > 0 ? (u64)free_async_space * 1000 / (u64)entry->rate : 0;
+    overflow->exhaust_ms = exhaust_ms > 0xffffffff ? 0xffffffff : exhaust_ms;
+    overflow->nr_senders = entry->nr_senders;
+    overflow->reserved = 0;
+    memcpy(overflow->senders, entry->senders, sizeof(overflow->senders));
+    // 按占用字节数排序
+    for (int i = 1; i < overflow->nr_senders; i++) {
+      struct rekernel_overflow_sender sender = overflow->senders[i];
+      int j = i - 1;
+      for (; j >= 0 && overflow->senders[j].bytes < sender.bytes; j--) {
+        overflow->senders[j + 1] = overflow->senders[j];
+      }
+      overflow->senders[j + 1] = sender;
+    }
+  }
+  spin_unlock(&entry->lock);
+  rekernel_irq_restore(flags);
+  return report;
+}
+
+static bool binder_can_update_transaction(struct binder_transaction* t1, struct binder_transaction* t2) {
+  struct binder_proc* t1_to_proc = binder_transaction_to_proc(t1);
+  struct binder_buffer* t1_buffer = binder_transaction_buffer(t1);
+  unsigned int t1_code = binder_transaction_code(t1);
+  unsigned int t1_flags = binder_transaction_flags(t1);
+  binder_uintptr_t t1_ptr = binder_node_ptr(t1_buffer->target_node);
+  binder_uintptr_t t1_cookie = binder_node_cookie(t1_buffer->target_node);
+
+  struct binder_proc* t2_to_proc = binder_transaction_to_proc(t2);
+  struct binder_buffer* t2_buffer = binder_transaction_buffer(t2);
+  unsigned int t2_code = binder_transaction_code(t2);
+  unsigned int t2_flags = binder_transaction_flags(t2);
+  binder_uintptr_t t2_ptr = binder_node_ptr(t2_buffer->target_node);
+  binder_uintptr_t t2_cookie = binder_node_cookie(t2_buffer->target_node);
 
-    struct binder_alloc* target_alloc = binder_proc_alloc(to_proc);
-    size_t free_async_space = binder_alloc_free_async_space(target_alloc);
-    size_t buffer_size = binder_alloc_buffer_size(target_alloc);
-    if (free_async_space < (buffer_size / 10 + 0x300)) {
-      binder_overflow_handler(task_tgid_nr(current), current, to_proc->pid, to_proc->tsk, true);
+  if ((t1_flags & t2_flags & TF_ONE_WAY) != TF_ONE_WAY || !t1_to_proc || !t2_to_proc)
+    return false;
+  if (t1_to_proc->tsk == t2_to_proc->tsk && t1_code == t2_code && t1_flags == t2_flags
+      && (struct_offset.binder_proc_is_frozen > 0 ? t1_buffer->pid == t2_buffer->pid : true)  // 4.19 以下无此数据
+      && t1_ptr == t2_ptr && t1_cookie == t2_cookie)
+    return true;
+  return false;
+}
+
+// keep 大于 1 时保留最早的一个, 与之前的版本相同, 再保留最新的 keep - 2 个, 加上新的消息共 keep 个
+// keep 为 1 时只保留新的消息
+static inline unsigned int binder_reclaim_skip(unsigned int keep, bool* keep_oldest) {
+  *keep_oldest = keep > 1;
+  return keep - 1 - *keep_oldest;
+}
+
+// 从最新的消息向前查找, 跳过需要保留的消息, 之后的都是过时消息, 最多返回 max 个
+static int binder_find_outdated_transactions_ilocked(struct binder_transaction* t, struct list_head* target_list,
+                                                     unsigned int keep, struct binder_transaction** outdated,
+                                                     int max) {
+  struct binder_work* w;
+  bool keep_oldest, more = false;
+  unsigned int skip = binder_reclaim_skip(keep, &keep_oldest);
+  int count = 0;
+
+  list_for_each_entry_reverse(w, target_list, entry) {
+    if (w->type != BINDER_WORK_TRANSACTION)
+      continue;
+    struct binder_transaction* t_queued = container_of(w, struct binder_transaction, work);
+    if (binder_can_update_transaction(t_queued, t)) {
+      if (skip) {
+        skip--;
+        continue;
+      }
+      if (count == max) {
+        more = true;
+        break;
+      }
+      outdated[count++] = t_queued;
     }
   }
+  // 最后一个是最早的消息
+  if (keep_oldest && !more && count)
+    count--;
+  return count;
+}
+
+// async_todo 的镜像索引, 按 (to_proc, code, flags, ptr, cookie, pid) 的哈希查找过时消息
+// binder 只在头部出队, 在尾部入队, 每次 hook 时先弹出镜像中已出队的部分, 再从尾部补齐新入队的部分
+// 镜像与 async_todo 的首尾不一致时重建, 命中后仍通过 binder_can_update_transaction 确认
+// 首尾检查无法发现解冻期间整个队列被取空后地址被复用, 因此 hook 看到目标未冻结或 node 没有异步消息时丢弃索引
+// 所有操作持有 node lock 和 inner lock, async_index_lock 嵌套在内
+// 索引是全局的, 所有 node 共用 async_index_lock, 按 ASYNC_INDEX_NODES 个槽位线性查找 node
+// 只有发往冻结目标的 oneway 消息会加锁, 其余只做不加锁的预检查
+struct async_entry {
+  struct list_head* work;
+  uint32_t hash;
+  int16_t node;
+  int32_t prev, next;
+  int32_t hprev, hnext;
+};
+struct async_node {
+  struct binder_node* node;
+  int debug_id;
+  int32_t head, tail;
+  u64 used;
+};
+struct async_index {
+  struct async_node nodes[ASYNC_INDEX_NODES];
+  int32_t bhead[ASYNC_INDEX_BUCKETS];
+  int32_t btail[ASYNC_INDEX_BUCKETS];
+  int32_t free;
+  u64 clock;
+  struct async_entry entries[ASYNC_INDEX_ENTRIES];
+};
+static struct async_index* async_index;
+static spinlock_t async_index_lock;
+
+static int binder_async_index_init(void) {
+  async_index = vzalloc(sizeof(struct async_index));
+  if (!async_index)
+    return -ENOMEM;
+  for (int i = 0; i < ASYNC_INDEX_NODES; i++) {
+    async_index->nodes[i].head = async_index->nodes[i].tail = ASYNC_INDEX_NIL;
+  }
+  for (int i = 0; i < ASYNC_INDEX_BUCKETS; i++) {
+    async_index->bhead[i] = async_index->btail[i] = ASYNC_INDEX_NIL;
+  }
+  for (int i = 0; i < ASYNC_INDEX_ENTRIES; i++) {
+    async_index->entries[i].next = i + 1 < ASYNC_INDEX_ENTRIES ? i + 1 : ASYNC_INDEX_NIL;
+  }
+  async_index->free = 0;
+  return 0;
+}
+
+static inline uint32_t async_bucket(int node, uint32_t hash) {
+  return (hash ^ (node * 0x9E3779B9)) & (ASYNC_INDEX_BUCKETS - 1);
+}
+
+static uint32_t binder_transaction_hash(struct binder_transaction* t) {
+  struct binder_proc* to_proc = binder_transaction_to_proc(t);
+  struct binder_buffer* buffer = binder_transaction_buffer(t);
+  if (!to_proc || !buffer || !buffer->target_node)
+    return 0;
+
+  u64 hash = (uintptr_t)to_proc->tsk;
+  hash = hash * 31 + binder_transaction_code(t);
+  hash = hash * 31 + binder_transaction_flags(t);
+  hash = hash * 31 + binder_node_ptr(buffer->target_node);
+  hash = hash * 31 + binder_node_cookie(buffer->target_node);
+  if (struct_offset.binder_proc_is_frozen > 0) {
+    hash = hash * 31 + buffer->pid;
+  }
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static void async_entry_unlink(int32_t i) {
+  struct async_entry* e = &async_index->entries[i];
+  struct async_node* n = &async_index->nodes[e->node];
+  if (e->prev != ASYNC_INDEX_NIL) {
+    async_index->entries[e->prev].next = e->next;
+  } else {
+    n->head = e->next;
+  }
+  if (e->next != ASYNC_INDEX_NIL) {
+    async_index->entries[e->next].prev = e->prev;
+  } else {
+    n->tail = e->prev;
+  }
+
+  uint32_t b = async_bucket(e->node, e->hash);
+  if (e->hprev != ASYNC_INDEX_NIL) {
+    async_index->entries[e->hprev].hnext = e->hnext;
+  } else {
+    async_index->bhead[b] = e->hnext;
+  }
+  if (e->hnext != ASYNC_INDEX_NIL) {
+    async_index->entries[e->hnext].hprev = e->hprev;
+  } else {
+    async_index->btail[b] = e->hprev;
+  }
+
+  e->work = NULL;
+  e->next = async_index->free;
+  async_index->free = i;
+}
+
+static bool async_entry_append(int node, struct list_head* work) {
+  int32_t i = async_index->free;
+  if (i == ASYNC_INDEX_NIL)
+    return false;
+  struct async_entry* e = &async_index->entries[i];
+  async_index->free = e->next;
+
+  struct binder_work* w = container_of(work, struct binder_work, entry);
+  struct async_node* n = &async_index->nodes[node];
+  e->work = work;
+  e->hash = w->type == BINDER_WORK_TRANSACTION
+                ? binder_transaction_hash(container_of(w, struct binder_transaction, work))
+                : 0;
+  e->node = node;
+  e->prev = n->tail;
+  e->next = ASYNC_INDEX_NIL;
+  if (n->tail != ASYNC_INDEX_NIL) {
+    async_index->entries[n->tail].next = i;
+  } else {
+    n->head = i;
+  }
+  n->tail = i;
+
+  uint32_t b = async_bucket(node, e->hash);
+  e->hprev = async_index->btail[b];
+  e->hnext = ASYNC_INDEX_NIL;
+  if (async_index->btail[b] != ASYNC_INDEX_NIL) {
+    async_index->entries[async_index->btail[b]].hnext = i;
+  } else {
+    async_index->bhead[b] = i;
+  }
+  async_index->btail[b] = i;
+  return true;
 }
 
-static bool binder_can_update_transaction(struct binder_transaction* t1, struct binder_transaction* t2) {
-  struct binder_proc* t1_to_proc = binder_transaction_to_proc(t1);
-  struct binder_buffer* t1_buffer = binder_transaction_buffer(t1);
-  unsigned int t1_code = binder_transaction_code(t1);
-  unsigned int t1_flags = binder_transaction_flags(t1);
-  binder_uintptr_t t1_ptr = binder_node_ptr(t1_buffer->target_node);
-  binder_uintptr_t t1_cookie = binder_node_cookie(t1_buffer->target_node);
+static void async_node_clear(int node) {
+  while (async_index->nodes[node].head != ASYNC_INDEX_NIL) {
+    async_entry_unlink(async_index->nodes[node].head);
+  }
+}
 
-  struct binder_proc* t2_to_proc = binder_transaction_to_proc(t2);
-  struct binder_buffer* t2_buffer = binder_transaction_buffer(t2);
-  unsigned int t2_code = binder_transaction_code(t2);
-  unsigned int t2_flags = binder_transaction_flags(t2);
-  binder_uintptr_t t2_ptr = binder_node_ptr(t2_buffer->target_node);
-  binder_uintptr_t t2_cookie = binder_node_cookie(t2_buffer->target_node);
+// 查找 node 对应的索引, 没有时替换最久未使用的
+static int async_node_get(struct binder_node* node) {
+  int victim = 0;
+  for (int i = 0; i < ASYNC_INDEX_NODES; i++) {
+    struct async_node* n = &async_index->nodes[i];
+    if (n->node == node) {
+      // node 已释放并被重新分配
+      if (n->debug_id != node->debug_id) {
+        async_node_clear(i);
+        n->debug_id = node->debug_id;
+      }
+      n->used = ++async_index->clock;
+      return i;
+    }
+    if (n->used < async_index->nodes[victim].used) {
+      victim = i;
+    }
+  }
+  async_node_clear(victim);
+  async_index->nodes[victim].node = node;
+  async_index->nodes[victim].debug_id = node->debug_id;
+  async_index->nodes[victim].used = ++async_index->clock;
+  return victim;
+}
 
-  if ((t1_flags & t2_flags & TF_ONE_WAY) != TF_ONE_WAY || !t1_to_proc || !t2_to_proc)
-    return false;
-  if (t1_to_proc->tsk == t2_to_proc->tsk && t1_code == t2_code && t1_flags == t2_flags
-      && (struct_offset.binder_proc_is_frozen > 0 ? t1_buffer->pid == t2_buffer->pid : true)  // 4.19 以下无此数据
-      && t1_ptr == t2_ptr && t1_cookie == t2_cookie)
+// 使镜像与 async_todo 一致, 条目不足时返回 false
+static bool async_node_sync(int node, struct list_head* async_todo) {
+  struct async_node* n = &async_index->nodes[node];
+  if (list_empty(async_todo)) {
+    async_node_clear(node);
     return true;
-  return false;
+  }
+  // 弹出已出队的部分
+  while (n->head != ASYNC_INDEX_NIL && async_index->entries[n->head].work != async_todo->next) {
+    async_entry_unlink(n->head);
+  }
+  // 从尾部找到镜像的最后一个条目, 找不到时重建
+  struct list_head* last = n->tail != ASYNC_INDEX_NIL ? async_index->entries[n->tail].work : NULL;
+  struct list_head* pos = async_todo->prev;
+  while (pos != async_todo && pos != last) {
+    pos = pos->prev;
+  }
+  if (pos == async_todo && last) {
+    async_node_clear(node);
+  }
+  for (pos = pos->next; pos != async_todo; pos = pos->next) {
+    if (!async_entry_append(node, pos)) {
+      async_node_clear(node);
+      return false;
+    }
+  }
+  return true;
 }
 
-static struct binder_transaction* binder_find_outdated_transaction_ilocked(struct binder_transaction* t,
-                                                                           struct list_head* target_list) {
-  struct binder_work* w;
-  bool second = false;
-
-  list_for_each_entry(w, target_list, entry) {
-    if (w->type != BINDER_WORK_TRANSACTION)
-      continue;
-    struct binder_transaction* t_queued = container_of(w, struct binder_transaction, work);
-    if (binder_can_update_transaction(t_queued, t)) {
-      if (second)
-        return t_queued;
-      else {
-        second = true;
+// 与 binder_find_outdated_transactions_ilocked 相同, 并从索引中移除返回的消息
+// 索引不可用时返回 -1
+static int binder_find_outdated_transactions_indexed(struct binder_node* node, struct binder_transaction* t,
+                                                     struct list_head* async_todo, unsigned int keep,
+                                                     struct binder_transaction** outdated, int max) {
+  if (!async_index)
+    return -1;
+
+  int count = -1;
+  spin_lock(&async_index_lock);
+  int slot = async_node_get(node);
+  if (async_node_sync(slot, async_todo)) {
+    count = 0;
+    bool keep_oldest, more = false;
+    unsigned int skip = binder_reclaim_skip(keep, &keep_oldest);
+    int32_t found[BINDER_RECLAIM_BATCH];
+    uint32_t hash = binder_transaction_hash(t);
+    int32_t i = async_index->btail[async_bucket(slot, hash)];
+    while (i != ASYNC_INDEX_NIL) {
+      struct async_entry* e = &async_index->entries[i];
+      if (e->node == slot && e->hash == hash) {
+        struct binder_work* w = container_of(e->work, struct binder_work, entry);
+        struct binder_transaction* t_queued = container_of(w, struct binder_transaction, work);
+        if (w->type == BINDER_WORK_TRANSACTION && binder_can_update_transaction(t_queued, t)) {
+          if (skip) {
+            skip--;
+          } else if (count == max || count == BINDER_RECLAIM_BATCH) {
+            more = true;
+            break;
+          } else {
+            found[count] = i;
+            outdated[count++] = t_queued;
+          }
+        }
       }
+      i = e->hprev;
+    }
+    // 最后一个是最早的消息
+    if (keep_oldest && !more && count)
+      count--;
+    for (int j = 0; j < count; j++) {
+      async_entry_unlink(found[j]);
     }
   }
-  return NULL;
+  spin_unlock(&async_index_lock);
+  return count;
+}
+
+// TF_UPDATE_TXN 会在 binder 中移除队列中间的消息, 丢弃索引
+static void binder_async_index_drop(struct binder_node* node) {
+  if (!async_index)
+    return;
+  // 不加锁预检查, node 没有索引条目时跳过
+  bool indexed = false;
+  for (int i = 0; i < ASYNC_INDEX_NODES && !indexed; i++) {
+    indexed = __atomic_load_n(&async_index->nodes[i].node, __ATOMIC_RELAXED) == node
+              && __atomic_load_n(&async_index->nodes[i].head, __ATOMIC_RELAXED) != ASYNC_INDEX_NIL;
+  }
+  if (!indexed)
+    return;
+
+  spin_lock(&async_index_lock);
+  for (int i = 0; i < ASYNC_INDEX_NODES; i++) {
+    if (async_index->nodes[i].node == node) {
+      async_node_clear(i);
+    }
+  }
+  spin_unlock(&async_index_lock);
 }
 
-static inline void outstanding_txns_dec(struct binder_proc* proc) {
+// 调用时持有 inner lock, 返回 outstanding_txns 是否因此降为 0
+// binder_proc_transaction 中新消息随后计入, 冻结进程的清理中可能降为 0
+static inline bool outstanding_txns_dec(struct binder_proc* proc) {
   if (struct_offset.binder_proc_outstanding_txns > 0) {
     int* outstanding_txns = binder_proc_outstanding_txns(proc);
-    (*outstanding_txns)--;
+    if (*outstanding_txns > 0) {
+      return --(*outstanding_txns) == 0;
+    }
+  }
+  return false;
+}
+
+// 与 binder_dec_outstanding_txns 相同, 唤醒等待 BINDER_FREEZE 完成的线程
+static inline void binder_freeze_wake(struct binder_proc* proc) {
+  if (struct_offset.binder_proc_freeze_wait > 0 && binder_is_frozen(proc)) {
+    wake_up_interruptible_all(binder_proc_freeze_wait(proc));
   }
 }
 
@@ -475,56 +2833,385 @@ static inline void binder_stats_deleted(enum binder_stat_types type) {
   atomic_inc(binder_stats_deleted_addr);
 }
 
-static void binder_proc_transaction_before(hook_fargs3_t* args, void* udata) {
+// 超出预算时的释放规则, 在加锁前从 binder_budget 复制
+struct binder_budget_rule {
+  uint32_t budget;
+  uint32_t used;
+  bool name_match;
+  uint32_t nr_ranges;
+  struct rekernel_code_range ranges[REKERNEL_BUDGET_MAX_RANGES];
+};
+
+// 与 binder_alloc 计算 free_async_space 的方式相同
+static inline size_t binder_buffer_async_size(struct binder_buffer* buffer) {
+  return ALIGN(buffer->data_size, sizeof(void*)) + ALIGN(buffer->offsets_size, sizeof(void*))
+         + ALIGN(buffer->extra_buffers_size, sizeof(void*)) + sizeof(struct binder_buffer);
+}
+
+// 返回 true 时目标进程的异步消息超出预算, 且存在允许释放的消息
+// 同一个 binder_node 的消息 rpc_name 相同, 只读取新消息的 rpc_name
+static bool binder_budget_load(struct binder_transaction* t, struct binder_proc* proc,
+                               struct binder_budget_rule* rule) {
+  uint32_t bytes = __atomic_load_n(&binder_budget.bytes, __ATOMIC_RELAXED);
+  if (!bytes)
+    return false;
+  struct binder_alloc* target_alloc = binder_proc_alloc(proc);
+  size_t async_space = binder_alloc_buffer_size(target_alloc) / 2;
+  size_t free_async_space = binder_alloc_free_async_space(target_alloc);
+  size_t used = async_space > free_async_space ? async_space - free_async_space : 0;
+  if (used <= bytes)
+    return false;
+
+  char name[INTERFACETOKEN_BUFF_SIZE] = "";
+  if (__atomic_load_n(&binder_budget.nr_names, __ATOMIC_RELAXED)) {
+    struct binder_transaction_data* tr = binder_alloc_copy_from_buffer ? NULL : binder_current_tr();
+    if ((binder_alloc_copy_from_buffer || tr) && !binder_rpc_name(t, NULL, tr, name))
+      name[0] = '\0';
+  }
+
+  spin_lock(&binder_budget_lock);
+  rule->budget = binder_budget.bytes;
+  rule->used = used > 0xffffffff ? 0xffffffff : used;
+  rule->nr_ranges = binder_budget.nr_ranges;
+  memcpy(rule->ranges, binder_budget.ranges, sizeof(struct rekernel_code_range) * rule->nr_ranges);
+  rule->name_match = false;
+  for (uint32_t i = 0; name[0] && i < binder_budget.nr_names; i++) {
+    if (!strcmp(name, binder_budget.names[i])) {
+      rule->name_match = true;
+      break;
+    }
+  }
+  spin_unlock(&binder_budget_lock);
+  return rule->budget && used > rule->budget && (rule->name_match || rule->nr_ranges);
+}
+
+static inline bool binder_budget_droppable(const struct binder_budget_rule* rule, unsigned int code) {
+  if (rule->name_match)
+    return true;
+  for (uint32_t i = 0; i < rule->nr_ranges; i++) {
+    if (code >= rule->ranges[i].start && code <= rule->ranges[i].end)
+      return true;
+  }
+  return false;
+}
+
+// 从最早的消息开始摘选允许释放的消息, 直到不超出预算, outdated 中已有的 count 个先计入, 最多返回 max 个
+static int binder_find_budget_transactions_ilocked(struct list_head* target_list,
+                                                   const struct binder_budget_rule* rule,
+                                                   struct binder_transaction** outdated, int count, int max,
+                                                   struct rekernel_budget* budget) {
+  size_t over = rule->used - rule->budget;
+  int outdated_count = count;
+  for (int i = 0; i < outdated_count; i++) {
+    size_t size = binder_buffer_async_size(binder_transaction_buffer(outdated[i]));
+    over = over > size ? over - size : 0;
+  }
+
+  struct binder_work* w;
+  list_for_each_entry(w, target_list, entry) {
+    if (!over || count == max)
+      break;
+    if (w->type != BINDER_WORK_TRANSACTION)
+      continue;
+    struct binder_transaction* t_queued = container_of(w, struct binder_transaction, work);
+    if (!binder_budget_droppable(rule, binder_transaction_code(t_queued)))
+      continue;
+    bool found = false;
+    for (int i = 0; i < outdated_count && !found; i++) {
+      found = outdated[i] == t_queued;
+    }
+    if (found)
+      continue;
+
+    size_t size = binder_buffer_async_size(binder_transaction_buffer(t_queued));
+    outdated[count++] = t_queued;
+    budget->count++;
+    budget->bytes += size;
+    over = over > size ? over - size : 0;
+  }
+  return count;
+}
+
+// 释放已从 async_todo 摘除的消息, 调用时不能持有 node lock 和 inner lock
+// 前 dedup 个是过时消息, 其余是超出预算释放的消息
+static void binder_release_outdated(struct binder_proc* proc, struct binder_transaction** outdated, int count,
+                                    int dedup) {
+  if (!count)
+    return;
+
+  struct binder_alloc* target_alloc = binder_proc_alloc(proc);
+  uid_t uid = task_uid(proc->tsk).val;
+  for (int i = 0; i < count; i++) {
+    struct binder_transaction* t_outdated = outdated[i];
+    struct binder_buffer* buffer = binder_transaction_buffer(t_outdated);
+    u64 size = buffer->data_size + buffer->offsets_size + buffer->extra_buffers_size;
+    if (i < dedup) {
+      reclaim_stats_add(uid, binder_transaction_code(t_outdated), size);
+    } else {
+      reclaim_stats_add_budget(size);
+    }
+
+    *(struct binder_buffer**)((uintptr_t)t_outdated + struct_offset.binder_transaction_buffer) = NULL;
+    buffer->transaction = NULL;
+    binder_release_entire_buffer(proc, NULL, buffer, false);
+    binder_alloc_free_buf(target_alloc, buffer);
+    kfree(t_outdated);
+    binder_stats_deleted(BINDER_STAT_TRANSACTION);
+  }
+#ifdef CONFIG_DEBUG
+  logkm("free_outdated pid=%d,uid=%d,count=%d\n", proc->pid, uid, count);
+#endif /* CONFIG_DEBUG */
+}
+
+static void binder_proc_transaction_handler(hook_fargs3_t* args) {
   struct binder_transaction* t = (struct binder_transaction*)args->arg0;
   struct binder_proc* proc = (struct binder_proc*)args->arg1;
 
   struct binder_buffer* buffer = binder_transaction_buffer(t);
   struct binder_node* node = buffer->target_node;
+  unsigned int flags = binder_transaction_flags(t);
   // 兼容不支持 trace 的内核
   if (trace == UZERO) {
     rekernel_binder_transaction(NULL, false, t, NULL);
+  } else if (binder_alloc_copy_from_buffer && (flags & TF_ONE_WAY)) {
+    binder_trans_handler(current, proc->tsk, true, t, NULL);
+  }
+  if (flags & TF_ONE_WAY) {
+    struct rekernel_overflow overflow;
+    if (binder_async_pressure(t, proc, &overflow)) {
+      binder_overflow_handler(current, proc->tsk, true, &overflow);
+    }
   }
-  unsigned int flags = binder_transaction_flags(t);
   if (!node || !(flags & TF_ONE_WAY))
     return;
+  if (flags & TF_UPDATE_TXN) {
+    binder_async_index_drop(node);
+    args->local.data0 = (uint64_t)node;
+  }
 
-  // binder 冻结时不再清理过时消息
-  if (binder_is_frozen(proc) || !frozen_task_group(proc->tsk))
+  // 索引不跟踪之后的出队, 不使用时丢弃
+  unsigned int keep = __atomic_load_n(&binder_reclaim_keep, __ATOMIC_RELAXED);
+  if (!keep && !__atomic_load_n(&binder_budget.bytes, __ATOMIC_RELAXED)) {
+    binder_async_index_drop(node);
+    return;
+  }
+  bool binder_frozen = binder_is_frozen(proc);
+  if (!binder_frozen && !frozen_task_group(proc->tsk)) {
+    binder_async_index_drop(node);
+    return;
+  }
+  bool reclaim = keep != 0;
+  if (binder_frozen) {
+    // binder 冻结期间 TF_UPDATE_TXN 可能移除队列中间的消息
+    binder_async_index_drop(node);
+    // 由 binder 自身替换过时消息
+    if ((flags & TF_UPDATE_TXN) && binder_find_outdated_transaction_ilocked)
+      reclaim = false;
+  }
+  struct binder_budget_rule rule;
+  bool over_budget = binder_budget_load(t, proc, &rule);
+  if (!reclaim && !over_budget)
     return;
 
   binder_node_lock(node);
   bool has_async_transaction = binder_node_has_async_transaction(node);
   if (!has_async_transaction) {
+    binder_async_index_drop(node);
     binder_node_unlock(node);
     return;
   }
   binder_inner_proc_lock(proc);
 
+  // 在锁内一次摘除所有过时消息, 解锁后批量释放
   struct list_head* async_todo = binder_node_async_todo(node);
-  struct binder_transaction* t_outdated = binder_find_outdated_transaction_ilocked(t, async_todo);
-  if (t_outdated) {
-    list_del_init(&t_outdated->work.entry);
-    outstanding_txns_dec(proc);
+  struct binder_transaction* outdated[BINDER_RECLAIM_BATCH];
+  int count = 0;
+  if (reclaim) {
+    count = binder_frozen ? -1
+                          : binder_find_outdated_transactions_indexed(node, t, async_todo, keep, outdated,
+                                                                      BINDER_RECLAIM_BATCH);
+    if (count < 0) {
+      count = binder_find_outdated_transactions_ilocked(t, async_todo, keep, outdated, BINDER_RECLAIM_BATCH);
+    }
+  }
+  // 过时消息释放后仍超出预算时, 再释放最早的消息
+  int dedup = count;
+  struct rekernel_budget budget = {0};
+  if (over_budget) {
+    count = binder_find_budget_transactions_ilocked(async_todo, &rule, outdated, count, BINDER_RECLAIM_BATCH, &budget);
+    if (budget.count) {
+      binder_async_index_drop(node);
+    }
+  }
+  bool idle = false;
+  for (int i = 0; i < count; i++) {
+    list_del_init(&outdated[i]->work.entry);
+    idle |= outstanding_txns_dec(proc);
+  }
+  if (idle) {
+    binder_freeze_wake(proc);
   }
 
   binder_inner_proc_unlock(proc);
   binder_node_unlock(node);
 
-  if (t_outdated) {
-    struct binder_alloc* target_alloc = binder_proc_alloc(proc);
-    struct binder_buffer* buffer = binder_transaction_buffer(t_outdated);
-#ifdef CONFIG_DEBUG
-    logkm("free_outdated pid=%d,uid=%d,data_size=%d\n", proc->pid, task_uid(proc->tsk).val, buffer->data_size);
-#endif /* CONFIG_DEBUG */
+  binder_release_outdated(proc, outdated, count, dedup);
+  if (budget.count) {
+    budget.budget = rule.budget;
+    budget.used = rule.used;
+    binder_budget_handler(current, proc->tsk, &budget);
+  }
+}
 
-    *(struct binder_buffer**)((uintptr_t)t_outdated + struct_offset.binder_transaction_buffer) = NULL;
-    buffer->transaction = NULL;
-    binder_release_entire_buffer(proc, NULL, buffer, false);
-    binder_alloc_free_buf(target_alloc, buffer);
-    kfree(t_outdated);
-    binder_stats_deleted(BINDER_STAT_TRANSACTION);
+static void binder_proc_transaction_before(hook_fargs3_t* args, void* udata) {
+  args->local.data0 = 0;
+  struct rekernel_hook_slot* slot = rekernel_hook_enter();
+  if (!slot)
+    return;
+  binder_proc_transaction_handler(args);
+  rekernel_hook_exit(slot);
+}
+
+// t 可能已被释放, 使用 before 中记录的 node
+static void binder_proc_transaction_after(hook_fargs3_t* args, void* udata) {
+  if (unlikely(args->local.data0)) {
+    struct rekernel_hook_slot* slot = rekernel_hook_enter();
+    if (!slot)
+      return;
+    binder_async_index_drop((struct binder_node*)args->local.data0);
+    rekernel_hook_exit(slot);
+  }
+}
+
+// 从最新的消息向前查找, 每组相同的消息按 binder_reclaim_skip 保留, 最新的一个视为新的消息
+// 最多跟踪 BINDER_SWEEP_GROUPS 组, 最多返回 max 个
+static int binder_find_duplicate_transactions_ilocked(struct list_head* target_list, unsigned int keep,
+                                                      struct binder_transaction** outdated, int max) {
+  struct binder_transaction* groups[BINDER_SWEEP_GROUPS];
+  unsigned int skipped[BINDER_SWEEP_GROUPS];
+  // 每组最后一个过时消息在 outdated 中的位置, 组内还有更早的消息时为 -1
+  int oldest[BINDER_SWEEP_GROUPS];
+  bool keep_oldest;
+  unsigned int skip = binder_reclaim_skip(keep, &keep_oldest);
+  int nr_groups = 0, count = 0;
+  struct binder_work* w;
+
+  list_for_each_entry_reverse(w, target_list, entry) {
+    if (w->type != BINDER_WORK_TRANSACTION)
+      continue;
+    struct binder_transaction* t_queued = container_of(w, struct binder_transaction, work);
+    int g = 0;
+    while (g < nr_groups && !binder_can_update_transaction(t_queued, groups[g]))
+      g++;
+    if (g == nr_groups) {
+      if (nr_groups < BINDER_SWEEP_GROUPS) {
+        groups[nr_groups] = t_queued;
+        skipped[nr_groups] = 0;
+        oldest[nr_groups++] = -1;
+      }
+      continue;
+    }
+    if (skipped[g] < skip) {
+      skipped[g]++;
+      continue;
+    }
+    if (count == max) {
+      oldest[g] = -1;
+      continue;
+    }
+    oldest[g] = count;
+    outdated[count++] = t_queued;
+  }
+  if (!keep_oldest)
+    return count;
+  // 保留每组最早的消息
+  for (int g = 0; g < nr_groups; g++) {
+    if (oldest[g] >= 0) {
+      outdated[oldest[g]] = NULL;
+    }
+  }
+  int n = 0;
+  for (int i = 0; i < count; i++) {
+    if (outdated[i]) {
+      outdated[n++] = outdated[i];
+    }
+  }
+  return n;
+}
+
+// 清理一个进程所有 binder_node 的 async_todo
+// 先在 inner lock 内收集节点并增加 tmp_refs, 再按 node lock -> inner lock 的顺序逐个清理
+static void binder_sweep_proc(struct binder_proc* proc) {
+  unsigned int keep = __atomic_load_n(&binder_reclaim_keep, __ATOMIC_RELAXED);
+  if (!keep || (!binder_is_frozen(proc) && !frozen_task_group(proc->tsk)))
+    return;
+
+  struct binder_node* nodes[BINDER_SWEEP_NODES];
+  int nr_nodes = 0;
+  binder_inner_proc_lock(proc);
+  for (struct rb_node* n = rb_first(&proc->nodes); n && nr_nodes < BINDER_SWEEP_NODES; n = rb_next(n)) {
+    struct binder_node* node = binder_node_from_rb(n);
+    // 未持有 node lock, 只作为提示, 清理时再次确认
+    if (binder_node_has_async_transaction(node)) {
+      (*binder_node_tmp_refs(node))++;
+      nodes[nr_nodes++] = node;
+    }
+  }
+  binder_inner_proc_unlock(proc);
+
+  for (int i = 0; i < nr_nodes; i++) {
+    struct binder_node* node = nodes[i];
+    struct binder_transaction* outdated[BINDER_RECLAIM_BATCH];
+    int count;
+    do {
+      count = 0;
+      binder_node_lock(node);
+      if (binder_node_has_async_transaction(node)) {
+        binder_inner_proc_lock(proc);
+        binder_async_index_drop(node);
+        count = binder_find_duplicate_transactions_ilocked(binder_node_async_todo(node), keep, outdated,
+                                                           BINDER_RECLAIM_BATCH);
+        bool idle = false;
+        for (int j = 0; j < count; j++) {
+          list_del_init(&outdated[j]->work.entry);
+          idle |= outstanding_txns_dec(proc);
+        }
+        if (idle) {
+          binder_freeze_wake(proc);
+        }
+        binder_inner_proc_unlock(proc);
+      }
+      binder_node_unlock(node);
+      binder_release_outdated(proc, outdated, count, count);
+    } while (count > 0);
+    binder_dec_node_tmpref(node);
+  }
+}
+
+// 持有 binder_procs_lock 时 binder_proc 不会被释放
+static void binder_sweep_frozen(void) {
+  if (!__atomic_exchange_n(&binder_sweep_pending, false, __ATOMIC_ACQ_REL))
+    return;
+
+  bool found = false;
+  for (int i = 0; i < FROZEN_PID_MAX / FROZEN_LONG_BITS; i++) {
+    frozen_map->sweeping[i] = __atomic_exchange_n(&frozen_map->sweep[i], 0, __ATOMIC_ACQ_REL);
+    found |= frozen_map->sweeping[i] != 0;
+  }
+  if (!found)
+    return;
+
+  // 同一进程可能同时打开 binder, hwbinder 和 vndbinder
+  mutex_lock(kvar(binder_procs_lock));
+  for (struct hlist_node* pos = kvar(binder_procs)->first; pos; pos = pos->next) {
+    struct binder_proc* proc = container_of(pos, struct binder_proc, proc_node);
+    pid_t pid = proc->pid;
+    if (pid > 0 && pid < FROZEN_PID_MAX
+        && (frozen_map->sweeping[pid / FROZEN_LONG_BITS] & (1UL << (pid % FROZEN_LONG_BITS)))) {
+      binder_sweep_proc(proc);
+    }
   }
+  mutex_unlock(kvar(binder_procs_lock));
 }
 
 static void binder_transaction_before(hook_fargs5_t* args, void* udata) {
@@ -548,7 +3235,14 @@ static void do_send_sig_info_before(hook_fargs4_t* args, void* udata) {
   struct task_struct* dst = (struct task_struct*)args->arg2;
 
   if (sig == SIGKILL || sig == SIGTERM || sig == SIGABRT || sig == SIGQUIT) {
-    rekernel_report(SIGNAL, sig, task_tgid_nr(current), current, task_tgid_nr(dst), dst, false);
+    struct rekernel_hook_slot* slot = rekernel_hook_enter();
+    if (!slot)
+      return;
+    struct rekernel_task src_snap, dst_snap;
+    rekernel_task_snapshot(&src_snap, current);
+    rekernel_task_snapshot(&dst_snap, dst);
+    rekernel_report(SIGNAL, sig, &src_snap, &dst_snap, false, NULL, NULL);
+    rekernel_hook_exit(slot);
   }
 }
 
@@ -557,29 +3251,212 @@ static inline bool sk_fullsock(const struct sock* sk) {
   return (1 << sk->sk_state) & ~(TCPF_TIME_WAIT | TCPF_NEW_SYN_RECV);
 }
 
+// 按 uid 合并网络事件, start_ns 为 0 时下一个包立即上报
+struct network_window {
+  uid_t uid;
+  int version;
+  u32 packets;
+  u32 bytes;
+  u64 start_ns;
+};
+static struct network_window network_windows[NETWORK_WINDOW_SIZE];
+static spinlock_t network_window_lock;
+
+static inline unsigned int network_window_hash(uid_t uid) {
+  return ((uid * 0x9E3779B1u) >> 16) & (NETWORK_WINDOW_SIZE - 1);
+}
+
+static inline void network_window_report(const struct network_window* window) {
+  struct rekernel_network network = {.packets = window->packets, .bytes = window->bytes};
+  struct rekernel_task dst = {.uid = window->uid};
+  rekernel_report(NETWORK, window->version, NULL, &dst, true, NULL, &network);
+}
+
+// 表满时替换最早开始的窗口, 其中未上报的部分写入 evicted
+static struct network_window* network_window_get(uid_t uid, struct network_window* evicted) {
+  unsigned int start = network_window_hash(uid);
+  struct network_window* victim = NULL;
+  for (int i = 0; i < NETWORK_WINDOW_PROBE; i++) {
+    struct network_window* window = &network_windows[(start + i) & (NETWORK_WINDOW_SIZE - 1)];
+    if (window->uid == uid)
+      return window;
+    if (!victim || !window->uid || window->start_ns < victim->start_ns)
+      victim = window;
+  }
+  *evicted = *victim;
+  memset(victim, 0, sizeof(*victim));
+  victim->uid = uid;
+  return victim;
+}
+
+// 返回 true 时 report 为需要立即上报的内容
+static bool network_window_account(uid_t uid, int version, u32 bytes, struct network_window* report,
+                                   struct network_window* evicted) {
+  u64 now = ktime_get_mono_fast_ns();
+  u64 interval = __atomic_load_n(&network_interval, __ATOMIC_RELAXED);
+  bool immediate = false;
+
+  unsigned long flags = rekernel_irq_save();
+  spin_lock(&network_window_lock);
+  struct network_window* window = network_window_get(uid, evicted);
+  window->version = version;
+  window->packets++;
+  window->bytes += bytes;
+  if (!window->start_ns || now - window->start_ns >= interval) {
+    immediate = true;
+    *report = *window;
+    window->packets = 0;
+    window->bytes = 0;
+    window->start_ns = now;
+  }
+  spin_unlock(&network_window_lock);
+  rekernel_irq_restore(flags);
+  return immediate;
+}
+
+static void network_window_reset(uid_t uid) {
+  unsigned long flags = rekernel_irq_save();
+  spin_lock(&network_window_lock);
+  unsigned int start = network_window_hash(uid);
+  for (int i = 0; i < NETWORK_WINDOW_PROBE; i++) {
+    struct network_window* window = &network_windows[(start + i) & (NETWORK_WINDOW_SIZE - 1)];
+    if (window->uid == uid) {
+      window->start_ns = 0;
+      break;
+    }
+  }
+  spin_unlock(&network_window_lock);
+  rekernel_irq_restore(flags);
+}
+
+// 由 flush 线程上报窗口结束后仍未上报的部分
+static void network_window_flush(void) {
+  struct network_window reports[NETWORK_WINDOW_SIZE];
+  int nr_reports = 0;
+  u64 now = ktime_get_mono_fast_ns();
+  u64 interval = __atomic_load_n(&network_interval, __ATOMIC_RELAXED);
+
+  unsigned long flags = rekernel_irq_save();
+  spin_lock(&network_window_lock);
+  for (int i = 0; i < NETWORK_WINDOW_SIZE; i++) {
+    struct network_window* window = &network_windows[i];
+    if (window->packets && now - window->start_ns >= interval) {
+      reports[nr_reports++] = *window;
+      window->packets = 0;
+      window->bytes = 0;
+      window->start_ns = now;
+    }
+  }
+  spin_unlock(&network_window_lock);
+  rekernel_irq_restore(flags);
+
+  for (int i = 0; i < nr_reports; i++) {
+    network_window_report(&reports[i]);
+  }
+}
+
+// sock 的 uid 缓存, 以 (sk, addrpair, portpair) 为键, 避免 sock_i_uid 获取 sk_callback_lock
+// 写者通过 seq 的奇偶互斥, 读者检测到并发写入时视为未命中
+struct sock_uid_entry {
+  uint32_t seq;
+  uid_t uid;
+  struct sock* sk;
+  __addrpair addrpair;
+  __portpair portpair;
+};
+static struct sock_uid_entry sock_uid_cache[SOCK_UID_CACHE_SIZE];
+
+static inline struct sock_uid_entry* sock_uid_entry(struct sock* sk) {
+  uintptr_t hash = (uintptr_t)sk >> 6;
+  hash ^= hash >> 10;
+  return &sock_uid_cache[hash & (SOCK_UID_CACHE_SIZE - 1)];
+}
+
+// 优先不加锁读取 sk_uid, 其次查找缓存, 都不可用时调用 sock_i_uid
+static uid_t sock_uid(struct sock* sk) {
+  uid_t uid;
+  if (sock_sk_uid(sk, &uid))
+    return uid;
+
+  struct sock_uid_entry* entry = sock_uid_entry(sk);
+  uint32_t seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+  if (!(seq & 1) && entry->sk == sk) {
+    uid = entry->uid;
+    bool match = entry->addrpair == sk->sk_addrpair && entry->portpair == sk->sk_portpair;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (match && __atomic_load_n(&entry->seq, __ATOMIC_RELAXED) == seq)
+      return uid;
+  }
+
+  uid = sock_i_uid(sk).val;
+  if (!(seq & 1)
+      && __atomic_compare_exchange_n(&entry->seq, &seq, seq + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    entry->sk = sk;
+    entry->uid = uid;
+    entry->addrpair = sk->sk_addrpair;
+    entry->portpair = sk->sk_portpair;
+    __atomic_store_n(&entry->seq, seq + 2, __ATOMIC_RELEASE);
+  }
+  return uid;
+}
+
+// tcp 和 udp 共用的 uid 解析, 冻结过滤和合并
+static void network_rcv(struct sock* sk, struct sk_buff* skb, int version) {
+  uid_t uid = sock_uid(sk);
+  if (uid < MIN_USERAPP_UID || !frozen_uid_maybe(uid))
+    return;
+
+  struct network_window report, evicted = {0};
+  bool immediate = network_window_account(uid, version, sk_buff_len(skb), &report, &evicted);
+  if (evicted.packets) {
+    network_window_report(&evicted);
+  }
+  if (immediate) {
+    network_window_report(&report);
+  }
+}
+
 static void tcp_rcv_before(hook_fargs1_t* args, void* udata) {
+  struct rekernel_hook_slot* slot = rekernel_hook_enter();
+  if (!slot)
+    return;
   struct sk_buff* skb = (struct sk_buff*)args->arg0;
   struct sock* sk = skb->sk;
-  ;
-  if (sk == NULL || !sk_fullsock(sk))
-    return;
+  // 没有冻结的进程时不读取 sock
+  if (frozen_any() && sk != NULL && sk_fullsock(sk)) {
+    network_rcv(sk, skb, *(int*)udata);
+  }
+  rekernel_hook_exit(slot);
+}
 
-  uid_t uid = sock_i_uid(sk).val;
-  if (uid < MIN_USERAPP_UID)
+static void udp_enqueue_before(hook_fargs2_t* args, void* udata) {
+  struct rekernel_hook_slot* slot = rekernel_hook_enter();
+  if (!slot)
     return;
-
-  int version = *(int*)udata;
-  rekernel_report(NETWORK, 0, version, NULL, uid, NULL, true);
+  struct sock* sk = (struct sock*)args->arg0;
+  struct sk_buff* skb = (struct sk_buff*)args->arg1;
+  if (frozen_any() && sk != NULL) {
+    network_rcv(sk, skb, sk->sk_family == AF_INET6 ? ipv6_version : ipv4_version);
+  }
+  rekernel_hook_exit(slot);
 }
 #endif /* CONFIG_NETWORK */
 
 static long inline_hook_init(const char* args, const char* event, void* __user reserved) {
   lookup_name(cgroup_freezing);
+  lookup_name_continue(freeze_task);
+  lookup_name_continue(__thaw_task);
+  lookup_name_continue(cgroup_freeze_task);
+  lookup_name_continue(release_task);
 
   kfunc_lookup_name(__alloc_skb);
   kfunc_lookup_name(__nlmsg_put);
   kfunc_lookup_name(kfree_skb);
   kfunc_lookup_name(netlink_unicast);
+  kfunc_lookup_name(netlink_broadcast);
+  kfunc_lookup_name(netlink_has_listeners);
+  kfunc_lookup_name(netlink_capable);
   kfunc_lookup_name(netlink_rcv_skb);
 
   kvar_lookup_name(init_net);
@@ -589,10 +3466,36 @@ static long inline_hook_init(const char* args, const char* event, void* __user r
   kfunc_lookup_name(proc_mkdir);
   kfunc_lookup_name(proc_create_data);
   kfunc_lookup_name(proc_remove);
+  kfunc_lookup_name(vmalloc_user);
+  kfunc_lookup_name(remap_vmalloc_range);
+  kfunc_lookup_name(__init_waitqueue_head);
+  kfunc_lookup_name(__wake_up);
+  kfunc_lookup_name(seq_read_iter);
+  kfunc_lookup_name(simple_read_from_buffer);
 
   kfunc_lookup_name(tracepoint_probe_register);
   kfunc_lookup_name(tracepoint_probe_unregister);
 
+  kvar_lookup_name(cpu_number);
+  kvar_lookup_name(nr_cpu_ids);
+  kvar_lookup_name(pid_max);
+  kvar_lookup_name(init_task);
+  kfunc_lookup_name(complete);
+  kfunc_lookup_name(vzalloc);
+  kfunc_lookup_name(vfree);
+  kfunc_lookup_name(synchronize_rcu);
+  kfunc_lookup_name(msleep);
+  kfunc_lookup_name(__rcu_read_lock);
+  kfunc_lookup_name(__rcu_read_unlock);
+  kfunc_lookup_name(kthread_create_on_node);
+  kfunc_lookup_name(wake_up_process);
+  kfunc_lookup_name(kthread_stop);
+  kfunc_lookup_name(kthread_should_stop);
+  kfunc_lookup_name(wait_for_completion_interruptible_timeout);
+  kfunc_lookup_name(__msecs_to_jiffies);
+  kfunc_lookup_name(ktime_get_mono_fast_ns);
+  kfunc_lookup_name(find_task_by_vpid);
+
   kfunc_lookup_name(_raw_spin_lock);
   kfunc_lookup_name(_raw_spin_unlock);
   kvar_lookup_name(__tracepoint_binder_transaction);
@@ -611,7 +3514,19 @@ static long inline_hook_init(const char* args, const char* event, void* __user r
   kfunc_lookup_name(memdup_user);
 
   lookup_name(binder_proc_transaction);
-  lookup_name(binder_transaction);
+  lookup_name_continue(binder_alloc_copy_from_buffer);
+  if (!binder_alloc_copy_from_buffer) {
+    lookup_name(binder_transaction);
+  }
+  lookup_name_continue(binder_free_node);
+  lookup_name_continue(binder_find_outdated_transaction_ilocked);
+  kvar_lookup_name(binder_procs);
+  kvar_lookup_name(binder_procs_lock);
+  kfunc_lookup_name(mutex_lock);
+  kfunc_lookup_name(mutex_unlock);
+  kfunc_lookup_name(rb_first);
+  kfunc_lookup_name(rb_next);
+  lookup_name_continue(binder_dec_node_tmpref);
   lookup_name(do_send_sig_info);
 
 #ifdef CONFIG_NETWORK
@@ -619,6 +3534,7 @@ static long inline_hook_init(const char* args, const char* event, void* __user r
 
   lookup_name(tcp_v4_rcv);
   lookup_name(tcp_v6_rcv);
+  lookup_name_continue(__udp_enqueue_schedule_skb);
 #endif /* CONFIG_NETWORK */
 #ifdef CONFIG_DEBUG_CMDLINE
   kfunc_lookup_name(get_cmdline);
@@ -629,18 +3545,62 @@ static long inline_hook_init(const char* args, const char* event, void* __user r
   if (rc < 0)
     return rc;
 
+  rc = start_rekernel_flush();
+  if (rc < 0)
+    return rc;
+  // 失败时使用线性查找
+  binder_async_index_init();
+  // 失败时不统计
+  reclaim_nr_stats = *kvar(nr_cpu_ids);
+  reclaim_stats = vzalloc(sizeof(struct reclaim_cpu_stats) * reclaim_nr_stats);
+  // 失败时每次都读取 interface token
+  rpc_name_cache = vzalloc(sizeof(struct rpc_name_set) * RPC_NAME_CACHE_SETS);
+  // 失败时每次调用 cgroup_freezing
+  if (freeze_task && __thaw_task) {
+    frozen_map = vzalloc(sizeof(struct frozen_map));
+  }
+  // binder_dec_node_tmpref 被内联或 harmony 内核时只在新消息到达时清理
+  binder_sweep_supported = frozen_map && binder_dec_node_tmpref && kvar(binder_procs) && kvar(binder_procs_lock)
+                           && kfunc(mutex_lock) && kfunc(mutex_unlock) && kfunc(rb_first) && kfunc(rb_next)
+                           && struct_offset.binder_node_rb_node > 0 && struct_offset.binder_node_tmp_refs > 0;
+
   rc = tracepoint_probe_register(kvar(__tracepoint_binder_transaction), rekernel_binder_transaction, NULL);
   if (rc == 0) {
     trace = IZERO;
   }
 
-  hook_func(binder_proc_transaction, 3, binder_proc_transaction_before, NULL, NULL);
-  hook_func(binder_transaction, 5, binder_transaction_before, NULL, NULL);
+  hook_func(binder_proc_transaction, 3, binder_proc_transaction_before, binder_proc_transaction_after, NULL);
+  if (!binder_alloc_copy_from_buffer) {
+    hook_func(binder_transaction, 5, binder_transaction_before, NULL, NULL);
+  }
+  // binder_free_node 被内联时仅依靠 debug_id 识别复用的 binder_node
+  if (binder_free_node) {
+    hook_func(binder_free_node, 1, binder_free_node_before, NULL, NULL);
+  }
   hook_func(do_send_sig_info, 4, do_send_sig_info_before, NULL, NULL);
+  if (frozen_map) {
+    hook_func(freeze_task, 1, freeze_task_before, NULL, NULL);
+    hook_func(__thaw_task, 1, thaw_task_before, NULL, NULL);
+    // cgroup_freeze_task 被内联时 cgroupv2 冻结的进程只能通过 jobctl 判断
+    if (cgroup_freeze_task) {
+      hook_func(cgroup_freeze_task, 2, cgroup_freeze_task_before, NULL, NULL);
+    }
+    // release_task 被内联时只在重新冻结时按 uid 识别复用的 tgid
+    if (release_task) {
+      hook_func(release_task, 1, release_task_before, NULL, NULL);
+    }
+    // 位图不完整时 frozen_any 和 frozen_uid_maybe 总是返回 true, frozen_task_group 调用 cgroup_freezing
+    bool complete = frozen_map_scan() && cgroup_freeze_task && kvar(pid_max) && *kvar(pid_max) <= FROZEN_PID_MAX;
+    __atomic_store_n(&frozen_map_ready, complete, __ATOMIC_RELEASE);
+  }
 
 #ifdef CONFIG_NETWORK
   hook_func(tcp_v4_rcv, 1, tcp_rcv_before, NULL, &ipv4_version);
   hook_func(tcp_v6_rcv, 1, tcp_rcv_before, NULL, &ipv6_version);
+  // 被内联时只上报 tcp
+  if (__udp_enqueue_schedule_skb) {
+    hook_func(__udp_enqueue_schedule_skb, 2, udp_enqueue_before, NULL, NULL);
+  }
 #endif /* CONFIG_NETWORK */
 
   return 0;
@@ -654,24 +3614,54 @@ static long inline_hook_control0(const char* ctl_args, char* __user out_msg, int
 }
 
 static long inline_hook_exit(void* __user reserved) {
-  if (rekernel_netlink) {
-    netlink_kernel_release(rekernel_netlink);
-  }
-  if (rekernel_dir) {
-    proc_remove(rekernel_dir);
-  }
-
+  __atomic_store_n(&rekernel_unloading, true, __ATOMIC_SEQ_CST);
   tracepoint_probe_unregister(kvar(__tracepoint_binder_transaction), rekernel_binder_transaction, NULL);
 
   unhook_func(binder_proc_transaction);
-  unhook_func(binder_transaction);
+  if (!binder_alloc_copy_from_buffer) {
+    unhook_func(binder_transaction);
+  }
+  unhook_func(binder_free_node);
   unhook_func(do_send_sig_info);
+  unhook_func(freeze_task);
+  unhook_func(__thaw_task);
+  unhook_func(cgroup_freeze_task);
+  unhook_func(release_task);
 
 #ifdef CONFIG_NETWORK
   unhook_func(tcp_v4_rcv);
   unhook_func(tcp_v6_rcv);
+  unhook_func(__udp_enqueue_schedule_skb);
 #endif /* CONFIG_NETWORK */
 
+  // tracepoint 的 probe 在 rcu 读临界区中执行, inline hook 通过计数等待
+  synchronize_rcu();
+  rekernel_hook_drain();
+  stop_rekernel_flush();
+
+  if (rekernel_netlink) {
+    netlink_kernel_release(rekernel_netlink);
+  }
+  if (rekernel_dir) {
+    proc_remove(rekernel_dir);
+  }
+  if (rekernel_mmap) {
+    vfree(rekernel_mmap);
+  }
+  if (async_index) {
+    vfree(async_index);
+  }
+  if (rpc_name_cache) {
+    vfree(rpc_name_cache);
+  }
+  if (reclaim_stats) {
+    vfree(reclaim_stats);
+  }
+  if (frozen_map) {
+    __atomic_store_n(&frozen_map_ready, false, __ATOMIC_RELEASE);
+    vfree(frozen_map);
+  }
+
   return 0;
 }
 
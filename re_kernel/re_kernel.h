@@ -208,6 +208,20 @@ struct netlink_ext_ack {
   u8 cookie[NETLINK_MAX_COOKIE_LEN];
   u8 cookie_len;
 };
+struct scm_creds {
+  u32 pid;
+  kuid_t uid;
+  kgid_t gid;
+};
+struct netlink_skb_parms {
+  struct scm_creds creds;
+  __u32 portid;
+  __u32 dst_group;
+  __u32 flags;
+  struct sock* sk;
+  // unknow
+};
+#define NETLINK_CB(skb) (*(struct netlink_skb_parms*)&((skb)->cb))
 
 // tools/include/uapi/linux/netlink.h
 struct nlmsghdr {
@@ -222,6 +236,8 @@ struct nlmsghdr {
 #define NLMSG_HDRLEN ((int)NLMSG_ALIGN(sizeof(struct nlmsghdr)))
 #define NLMSG_LENGTH(len) ((len) + NLMSG_HDRLEN)
 #define NLMSG_DATA(nlh) ((void*)(((char*)nlh) + NLMSG_LENGTH(0)))
+#define NLM_F_MULTI 0x2
+#define NLMSG_DONE 0x3
 
 // linux/gfp.h
 #define NUMA_NO_NODE (-1)
@@ -233,7 +249,17 @@ struct nlmsghdr {
 #define __GFP_KSWAPD_RECLAIM ((__force gfp_t)___GFP_KSWAPD_RECLAIM)
 #define GFP_ATOMIC (__GFP_HIGH | __GFP_ATOMIC | __GFP_KSWAPD_RECLAIM)
 
+// linux/completion.h
+// 4.x 为 wait_queue_head_t, 5.x 以上为 swait_queue_head, 非调试内核布局一致
+struct completion {
+  unsigned int done;
+  raw_spinlock_t lock;
+  struct list_head task_list;
+};
+
 // linux/fs.h
+struct file;
+struct inode;
 struct kiocb;
 struct iov_iter;
 struct dir_context;
@@ -248,6 +274,39 @@ struct file_operations {
   char unknow[0x120];
 };
 
+// linux/proc_fs.h, 5.10 以上, CONFIG_COMPAT
+struct proc_ops {
+  unsigned int proc_flags;
+  int (*proc_open)(struct inode*, struct file*);
+  ssize_t (*proc_read)(struct file*, char __user*, size_t, loff_t*);
+  ssize_t (*proc_read_iter)(struct kiocb*, struct iov_iter*);
+  ssize_t (*proc_write)(struct file*, const char __user*, size_t, loff_t*);
+  loff_t (*proc_lseek)(struct file*, loff_t, int);
+  int (*proc_release)(struct inode*, struct file*);
+  __poll_t (*proc_poll)(struct file*, struct poll_table_struct*);
+  long (*proc_ioctl)(struct file*, unsigned int, unsigned long);
+  long (*proc_compat_ioctl)(struct file*, unsigned int, unsigned long);
+  int (*proc_mmap)(struct file*, struct vm_area_struct*);
+  unsigned long (*proc_get_unmapped_area)(struct file*, unsigned long, unsigned long, unsigned long, unsigned long);
+};
+
+// linux/wait.h
+#define TASK_INTERRUPTIBLE 1
+#define TASK_NORMAL 3
+struct wait_queue_head {
+  spinlock_t lock;
+  struct list_head head;
+};
+
+// linux/poll.h
+#define EPOLLIN 0x00000001
+#define EPOLLRDNORM 0x00000040
+typedef void (*poll_queue_proc)(struct file*, struct wait_queue_head*, struct poll_table_struct*);
+struct poll_table_struct {
+  poll_queue_proc _qproc;
+  __poll_t _key;
+};
+
 // linux/schde.h
 #define PF_FROZEN 0x00010000
 
@@ -259,7 +318,12 @@ struct file_operations {
 
 struct siginfo;
 
+// uapi/linux/capability.h
+#define CAP_NET_ADMIN 12
+
 // linux/socket.h
+#define AF_INET 2
+#define AF_INET6 10
 #define MSG_DONTWAIT 0x40
 
 // linux/tracepoint-defs.h
@@ -407,4 +471,265 @@ struct sk_buff {
   // unknow
 };
 
+// Re:Kernel netlink 协议
+// 守护进程通过 hello 控制消息选择事件格式, 旧守护进程不发送控制消息, 保持文本格式
+#define REKERNEL_MAGIC 0x4C4E4B52  // "RKNL"
+#define REKERNEL_EVENT_VERSION 1
+
+enum rekernel_format {
+  REKERNEL_FORMAT_TEXT,
+  REKERNEL_FORMAT_BINARY,
+};
+
+// 二进制事件的 nlmsg_type, 文本消息仍使用 netlink unit
+enum rekernel_msg_type {
+  REKERNEL_MSG_EVENT = 0x100,
+  REKERNEL_MSG_DROPPED,
+  REKERNEL_MSG_RECLAIM_STATS,
+};
+
+// 多播 group, 按事件类别划分, 订阅者总是收到二进制格式
+enum rekernel_group {
+  REKERNEL_GROUP_BINDER = 1,
+  REKERNEL_GROUP_SIGNAL,
+  REKERNEL_GROUP_NETWORK,
+  REKERNEL_GROUP_OVERFLOW,
+  __REKERNEL_GROUP_MAX,
+};
+#define REKERNEL_GROUP_MAX (__REKERNEL_GROUP_MAX - 1)
+
+// 除 HELLO 和 RECLAIM_STATS 外, 只接受 USER_PORT 上具有 CAP_NET_ADMIN 的发送者, 否则返回 -EPERM
+enum rekernel_ctl_cmd {
+  REKERNEL_CTL_HELLO,
+  REKERNEL_CTL_BATCH,
+  REKERNEL_CTL_FILTER,
+  REKERNEL_CTL_COALESCE,
+  REKERNEL_CTL_THAW_DEDUP,
+  REKERNEL_CTL_ACK,
+  REKERNEL_CTL_RECLAIM,
+  REKERNEL_CTL_RECLAIM_STATS,
+  REKERNEL_CTL_BUDGET,
+  REKERNEL_CTL_NETWORK,
+};
+
+struct rekernel_ctl {
+  __u32 magic;
+  __u16 version;
+  __u16 cmd;
+} __attribute__((packed));
+
+struct rekernel_ctl_hello {
+  struct rekernel_ctl hdr;
+  __u32 format;
+} __attribute__((packed));
+
+// 二进制格式下多个事件合并为一个 NLM_F_MULTI 消息, 以 NLMSG_DONE 结尾
+// 缓冲区满, 单个 cpu 积压 max_events 个事件, 或等待 deadline_ms 后发送, 同步 binder 和 signal 事件不等待
+struct rekernel_ctl_batch {
+  struct rekernel_ctl hdr;
+  __u32 deadline_ms;
+  __u32 max_events;
+} __attribute__((packed));
+
+// 相同 (reporttype, type, src_uid, dst_uid) 的事件在 window_ms 内只发送一次
+// 被合并的次数记录在下一个发送的事件的 repeat 中, window_ms 为 0 时关闭
+// network 事件已由 REKERNEL_CTL_NETWORK 按 uid 汇总, 不参与合并
+// 直接映射, 冲突时窗口内仍有计数的事件不被覆盖, 覆盖时未上报的计数计入 rekernel_dropped
+struct rekernel_ctl_coalesce {
+  struct rekernel_ctl hdr;
+  __u32 window_ms;
+} __attribute__((packed));
+
+// 目标 uid 上报后到解冻前, 后续的 binder/signal 事件只计数
+// 计数记录在该 uid 解冻后下一个发送的事件的 repeat 中
+struct rekernel_ctl_thaw_dedup {
+  struct rekernel_ctl hdr;
+  __u32 enable;
+} __attribute__((packed));
+
+// 守护进程处理完事件 (如解冻目标) 后回传 seq 和 timestamp
+// 内核统计 timestamp 到收到 ack 的延迟, 通过 /proc/rekernel/latency 读取
+// 只统计最近发送的 256 个事件, seq 与 timestamp 不一致或重复 ack 时忽略
+struct rekernel_ctl_ack {
+  struct rekernel_ctl hdr;
+  __u32 seq;
+  __u64 timestamp;
+} __attribute__((packed));
+
+// 冻结进程中相同的异步 binder 消息最多保留 keep 个 (包括新的消息), 其余的被释放
+// keep 大于 1 时保留最早的一个和最新的 keep - 1 个, 默认为 2, 即最早的和新的消息, 与之前的版本相同
+// keep 为 1 时只保留新的消息, 为 0 时不清理, 最大为 64
+struct rekernel_ctl_reclaim {
+  struct rekernel_ctl hdr;
+  __u32 keep;
+} __attribute__((packed));
+
+// REKERNEL_CTL_RECLAIM_STATS 只有 hdr, 回复 REKERNEL_MSG_RECLAIM_STATS
+// 从加载开始累计, bytes 为 data_size + offsets_size + extra_buffers_size
+// entries 为按 bytes 排序的前 REKERNEL_RECLAIM_STATS_MAX 个 (目标 uid, code), 其余计入 other
+#define REKERNEL_RECLAIM_STATS_MAX 32
+struct rekernel_reclaim_entry {
+  __u32 uid;
+  __u32 code;
+  __u64 count;
+  __u64 bytes;
+} __attribute__((packed));
+struct rekernel_reclaim_stats {
+  __u64 count;
+  __u64 bytes;
+  __u64 other_count;
+  __u64 other_bytes;
+  __u16 nr_entries;
+  __u16 reserved;
+  struct rekernel_reclaim_entry entries[REKERNEL_RECLAIM_STATS_MAX];
+} __attribute__((packed));
+
+// 过滤事件类型的掩码
+enum rekernel_filter_type {
+  REKERNEL_FILTER_BINDER_REPLY = 1 << 0,
+  REKERNEL_FILTER_BINDER_TRANSACTION = 1 << 1,
+  REKERNEL_FILTER_BINDER_OVERFLOW = 1 << 2,
+  REKERNEL_FILTER_SIGNAL = 1 << 3,
+  REKERNEL_FILTER_NETWORK = 1 << 4,
+  REKERNEL_FILTER_ALL = (1 << 5) - 1,
+};
+
+#define REKERNEL_FILTER_MAX_UIDS 64
+#define REKERNEL_FILTER_MAX_RANGES 8
+
+// 闭区间 [start, end]
+struct rekernel_code_range {
+  __u32 start;
+  __u32 end;
+} __attribute__((packed));
+
+// 在内核中过滤事件, 不匹配的事件在生成前丢弃, 对所有接收者生效
+// types: enum rekernel_filter_type 掩码
+// uids: 目标 uid, 即 binder/signal 的 dst_uid 和 network 的 uid, nr_uids 为 0 时不过滤
+// ranges: 异步 binder 的 code 范围, nr_ranges 为 0 时不过滤, 默认为 [29, 32]
+struct rekernel_ctl_filter {
+  struct rekernel_ctl hdr;
+  __u32 types;
+  __u16 nr_uids;
+  __u16 nr_ranges;
+  struct rekernel_code_range ranges[REKERNEL_FILTER_MAX_RANGES];
+  __u32 uids[REKERNEL_FILTER_MAX_UIDS];
+} __attribute__((packed));
+
+// 同一 uid 在 interval_ms 内收到的数据包合并为一个 NETWORK 事件, 窗口外的第一个包和冻结后的第一个包立即上报
+// interval_ms 为 0 时每个包都上报, 默认为 1000
+struct rekernel_ctl_network {
+  struct rekernel_ctl hdr;
+  __u32 interval_ms;
+} __attribute__((packed));
+
+// 冻结进程的每个目标进程中排队的异步消息最多占用 bytes 字节, 为 0 时不限制, 默认为 0
+// 超出时从最早的消息开始释放, 只释放 code 在 ranges 内或 rpc_name 在 names 中的消息, 都为空时不释放
+// 预算按单个目标进程的异步空间判断, 不按 uid 汇总, 只释放新消息所在 binder_node 的 async_todo 中的消息
+// 消息分散在多个 binder_node 或同一 uid 的多个进程时, 其他 node 上的消息不会因此释放
+// 每次释放后上报一个 BUDGET 事件, 与 OVERFLOW 使用相同的过滤类型和多播 group
+#define REKERNEL_BUDGET_MAX_RANGES 8
+#define REKERNEL_BUDGET_MAX_NAMES 8
+// 与 rpc_name 的最大长度相同, 以 '\0' 结尾
+#define REKERNEL_BUDGET_NAME_LEN 140
+struct rekernel_ctl_budget {
+  struct rekernel_ctl hdr;
+  __u32 bytes;
+  __u16 nr_ranges;
+  __u16 nr_names;
+  struct rekernel_code_range ranges[REKERNEL_BUDGET_MAX_RANGES];
+  char names[REKERNEL_BUDGET_MAX_NAMES][REKERNEL_BUDGET_NAME_LEN];
+} __attribute__((packed));
+
+// reporttype: enum report_type
+// type: BINDER 为 enum binder_type, SIGNAL 为信号值, NETWORK 为 ip 版本
+// rpc_name 紧跟在结构体之后, 以 '\0' 结尾, 没有时 rpc_name_offset 为 0
+// OVERFLOW 事件的 rpc_name_offset 处为 rekernel_overflow, rpc_name_len 为 0
+// repeat: 上一次发送后被合并的相同事件数
+// timestamp: hook 中的 CLOCK_MONOTONIC 时间, 单位 ns
+// seq: 发送时分配的全局递增序号, 缓冲区满而丢弃的事件同样占用序号, 缺少的序号表示有事件被丢弃
+//      高优先级的事件可能先于序号更小的低优先级事件到达
+struct rekernel_event {
+  __u16 version;
+  __u16 size;
+  __u8 reporttype;
+  __u8 type;
+  __u8 oneway;
+  __u8 reserved;
+  __s32 src_pid;
+  __u32 src_uid;
+  __s32 dst_pid;
+  __u32 dst_uid;
+  __u32 code;
+  __u16 rpc_name_offset;
+  __u16 rpc_name_len;
+  __u32 repeat;
+  __u64 timestamp;
+  __u32 seq;
+} __attribute__((packed));
+
+// 异步空间不足时占用最多的发送者
+#define REKERNEL_OVERFLOW_TOP 4
+struct rekernel_overflow_sender {
+  __u32 uid;
+  __u32 bytes;
+} __attribute__((packed));
+// rate: 异步空间消耗速度的指数移动平均, 单位 bytes/s
+// exhaust_ms: 按 rate 预计耗尽的时间, rate <= 0 时为 0
+// senders: 按占用字节数排序, 从冻结的目标进程低于恢复阈值后开始统计
+struct rekernel_overflow {
+  __u32 free_async_space;
+  __u32 buffer_size;
+  __s32 rate;
+  __u32 exhaust_ms;
+  __u16 nr_senders;
+  __u16 reserved;
+  struct rekernel_overflow_sender senders[REKERNEL_OVERFLOW_TOP];
+} __attribute__((packed));
+
+// BUDGET 事件的 rpc_name_offset 处为 rekernel_budget, rpc_name_len 为 0
+// used: 释放前目标进程异步消息占用的字节数, count 和 bytes 为本次释放的消息
+struct rekernel_budget {
+  __u32 budget;
+  __u32 used;
+  __u32 count;
+  __u32 bytes;
+} __attribute__((packed));
+
+// NETWORK 事件的 rpc_name_offset 处为 rekernel_network, rpc_name_len 为 0
+// packets 和 bytes 为上次上报后该 uid 收到的数据包, bytes 不可用时为 0
+struct rekernel_network {
+  __u32 packets;
+  __u32 bytes;
+} __attribute__((packed));
+
+// 上次发送后丢弃的事件数, 在 USER_PORT 恢复接收后发送
+// high: 同步 binder 和 signal, low: 异步 binder, overflow 和 network
+// 包括合并窗口冲突时被覆盖的 repeat 计数
+struct rekernel_dropped {
+  __u32 high;
+  __u32 low;
+} __attribute__((packed));
+
+// /proc/rekernel/events, 5.10 以上可用, 同一时间只允许一个进程打开
+// mmap 后读取, 不需要 netlink, 打开期间 USER_PORT 不再收到事件
+// 第一页为 rekernel_mmap_header, data_offset 之后为 nr_records 个 record_size 大小的记录
+// 内核推进 head, 守护进程读取后推进 tail, 下标为 index % nr_records, 可通过 poll 等待
+// 记录内容与二进制事件相同, 为 rekernel_event 及其 rpc_name
+#define REKERNEL_MMAP_MAGIC 0x4D4B4552
+#define REKERNEL_MMAP_RECORDS 1024
+#define REKERNEL_MMAP_RECORD_SIZE 192
+#define REKERNEL_MMAP_DATA_OFFSET 4096
+struct rekernel_mmap_header {
+  __u32 magic;
+  __u16 version;
+  __u16 record_size;
+  __u32 nr_records;
+  __u32 data_offset;
+  __u32 head;
+  __u32 tail;
+  __u32 dropped_high;
+  __u32 dropped_low;
+};
+
 #endif /* __RE_KERNEL_H */
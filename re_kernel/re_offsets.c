@@ -28,6 +28,12 @@ static inline spinlock_t* binder_proc_inner_lock(struct binder_proc* proc) {
   spinlock_t* inner_lock = (spinlock_t*)((uintptr_t)proc + struct_offset.binder_proc_inner_lock);
   return inner_lock;
 }
+//  binder_proc_freeze_wait
+static inline struct wait_queue_head* binder_proc_freeze_wait(struct binder_proc* proc) {
+  struct wait_queue_head* freeze_wait =
+      (struct wait_queue_head*)((uintptr_t)proc + struct_offset.binder_proc_freeze_wait);
+  return freeze_wait;
+}
 //  binder_proc_outstanding_txns
 static inline int* binder_proc_outstanding_txns(struct binder_proc* proc) {
   int* outstanding_txns = (int*)((uintptr_t)proc + struct_offset.binder_proc_outstanding_txns);
@@ -99,6 +105,30 @@ static inline struct list_head* binder_node_async_todo(struct binder_node* node)
   return async_todo;
 }
 
+// binder_node_tmp_refs
+static inline int* binder_node_tmp_refs(struct binder_node* node) {
+  int* tmp_refs = (int*)((uintptr_t)node + struct_offset.binder_node_tmp_refs);
+  return tmp_refs;
+}
+// binder_proc->nodes 中的 rb_node 转换为 binder_node
+static inline struct binder_node* binder_node_from_rb(struct rb_node* n) {
+  struct binder_node* node = (struct binder_node*)((uintptr_t)n - struct_offset.binder_node_rb_node);
+  return node;
+}
+// sk_buff_len, 不可用时为 0
+static inline unsigned int sk_buff_len(struct sk_buff* skb) {
+  if (struct_offset.sk_buff_len <= 0)
+    return 0;
+  unsigned int len = *(unsigned int*)((uintptr_t)skb + struct_offset.sk_buff_len);
+  return len;
+}
+// sock_sk_uid, 只有 vmlinux 中可以获取, 不可用时返回 false
+static inline bool sock_sk_uid(struct sock* sk, uid_t* uid) {
+  if (struct_offset.sock_sk_uid <= 0)
+    return false;
+  *uid = __atomic_load_n((uid_t*)((uintptr_t)sk + struct_offset.sock_sk_uid), __ATOMIC_RELAXED);
+  return true;
+}
 static long calculate_offsets() {
   // 获取 binder_transaction_buffer_release 版本, 以参数数量做判断
   uint32_t* binder_transaction_buffer_release_src = (uint32_t*)binder_transaction_buffer_release;
@@ -152,14 +182,17 @@ static long calculate_offsets() {
       struct_offset.binder_node_has_async_transaction = offset;
       struct_offset.binder_node_ptr = offset - 0x13;
       struct_offset.binder_node_cookie = offset - 0xB;
+      struct_offset.binder_node_tmp_refs = offset - 0x17;
       struct_offset.binder_node_async_todo = offset + 0x5;
       // 目前只有 harmony 内核需要特殊设置
       if (offset == 0x7B) {
         struct_offset.binder_node_lock = 0x8;
         struct_offset.binder_transaction_from = 0x28;
+        // harmony 内核 rb_node 位置未知, 不支持冻结时清理
       } else {
         struct_offset.binder_node_lock = 0x4;
         struct_offset.binder_transaction_from = 0x20;
+        struct_offset.binder_node_rb_node = offset - 0x4B;
       }
     } else if (!struct_offset.binder_transaction_buffer
                && inst_get_ldr_imm_uint_size(binder_proc_transaction_src[i]) == 0b11
@@ -173,6 +206,7 @@ static long calculate_offsets() {
       uint64_t binder_proc_sync_recv_offset = inst_get_strb_imm_uint_imm(binder_proc_transaction_src[i + 1]);
       struct_offset.binder_proc_is_frozen = binder_proc_sync_recv_offset - 1;
       struct_offset.binder_proc_outstanding_txns = binder_proc_sync_recv_offset - 0x6;
+      struct_offset.binder_proc_freeze_wait = binder_proc_sync_recv_offset + 0x6;
       break;
     }
   }
@@ -185,10 +219,13 @@ static long calculate_offsets() {
   logkm("binder_node_lock=0x%x\n", struct_offset.binder_node_lock);                                    // 0x4
   logkm("binder_node_ptr=0x%x\n", struct_offset.binder_node_ptr);                                      // 0x58
   logkm("binder_node_cookie=0x%x\n", struct_offset.binder_node_cookie);                                // 0x60
+  logkm("binder_node_tmp_refs=0x%x\n", struct_offset.binder_node_tmp_refs);                            // 0x54
+  logkm("binder_node_rb_node=0x%x\n", struct_offset.binder_node_rb_node);                              // 0x20
   logkm("binder_node_has_async_transaction=0x%x\n", struct_offset.binder_node_has_async_transaction);  // 0x6B
   logkm("binder_node_async_todo=0x%x\n", struct_offset.binder_node_async_todo);                        // 0x70
   logkm("binder_proc_outstanding_txns=0x%x\n", struct_offset.binder_proc_outstanding_txns);            // 0x6C
   logkm("binder_proc_is_frozen=0x%x\n", struct_offset.binder_proc_is_frozen);                          // 0x71
+  logkm("binder_proc_freeze_wait=0x%x\n", struct_offset.binder_proc_freeze_wait);                      // 0x78
 #endif /* CONFIG_DEBUG */
   if (struct_offset.binder_node_lock <= 0 || struct_offset.binder_node_has_async_transaction <= 0
       || struct_offset.binder_transaction_buffer <= 0)
@@ -367,6 +404,31 @@ static long calculate_offsets() {
 #endif                                                    /* CONFIG_DEBUG */
   if (struct_offset.binder_stats_deleted_transaction <= 0)
     return -11;
+
+#ifdef CONFIG_NETWORK
+  // 获取 sk_buff->len, 没有就不统计字节数
+  void* skb_pull;
+  lookup_name_continue(skb_pull);
+
+  uint32_t* skb_pull_src = (uint32_t*)skb_pull;
+  for (u32 i = 0; skb_pull && i < 0x10; i++) {
+#ifdef CONFIG_DEBUG
+    logkm("skb_pull %x %llx\n", i, skb_pull_src[i]);
+#endif /* CONFIG_DEBUG */
+    if (inst_is_ret(skb_pull_src[i])) {
+      break;
+    } else if (inst_get_ldr_imm_uint_size(skb_pull_src[i]) == 0b10 && inst_get_ldr_imm_uint_rn(skb_pull_src[i]) == 0) {
+      uint64_t offset = inst_get_ldr_imm_uint_imm(skb_pull_src[i]);
+      if (offset < 0x60 || offset > 0xA0)
+        continue;
+      struct_offset.sk_buff_len = offset;
+      break;
+    }
+  }
+#ifdef CONFIG_DEBUG
+  logkm("sk_buff_len=0x%x\n", struct_offset.sk_buff_len);  // 0x70
+#endif                                                    /* CONFIG_DEBUG */
+#endif /* CONFIG_NETWORK */
 #endif /* CONFIG_VMLINUX */
 
   return 0;
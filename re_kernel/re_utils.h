@@ -20,8 +20,11 @@ struct struct_offset {
   int16_t binder_node_has_async_transaction;
   int16_t binder_node_lock;
   int16_t binder_node_ptr;
+  int16_t binder_node_rb_node;
+  int16_t binder_node_tmp_refs;
   int16_t binder_proc_alloc;
   int16_t binder_proc_context;
+  int16_t binder_proc_freeze_wait;
   int16_t binder_proc_inner_lock;
   int16_t binder_proc_is_frozen;
   int16_t binder_proc_outer_lock;
@@ -32,6 +35,8 @@ struct struct_offset {
   int16_t binder_transaction_flags;
   int16_t binder_transaction_from;
   int16_t binder_transaction_to_proc;
+  int16_t sk_buff_len;
+  int16_t sock_sk_uid;
   int16_t task_struct_group_leader;
   int16_t task_struct_jobctl;
   int16_t task_struct_pid;
@@ -72,6 +77,21 @@ static inline int netlink_unicast(struct sock* ssk, struct sk_buff* skb, u32 por
   return -EFAULT;
 }
 
+extern int kfunc_def(netlink_broadcast)(struct sock* ssk, struct sk_buff* skb, u32 portid, u32 group,
+                                        gfp_t allocation);
+static inline int netlink_broadcast(struct sock* ssk, struct sk_buff* skb, u32 portid, u32 group, gfp_t allocation) {
+  kfunc_call(netlink_broadcast, ssk, skb, portid, group, allocation);
+  kfunc_not_found();
+  return -EFAULT;
+}
+
+extern int kfunc_def(netlink_has_listeners)(struct sock* sk, unsigned int group);
+static inline int netlink_has_listeners(struct sock* sk, unsigned int group) {
+  kfunc_call(netlink_has_listeners, sk, group);
+  kfunc_not_found();
+  return 0;
+}
+
 extern int kfunc_def(netlink_rcv_skb)(struct sk_buff* skb,
                                       int (*cb)(struct sk_buff*, struct nlmsghdr*, struct netlink_ext_ack*));
 static inline int netlink_rcv_skb(struct sk_buff* skb,
@@ -81,6 +101,13 @@ static inline int netlink_rcv_skb(struct sk_buff* skb,
   return -EFAULT;
 }
 
+extern bool kfunc_def(netlink_capable)(const struct sk_buff* skb, int cap);
+static inline bool netlink_capable(const struct sk_buff* skb, int cap) {
+  kfunc_call(netlink_capable, skb, cap);
+  kfunc_not_found();
+  return false;
+}
+
 extern struct sock* kfunc_def(__netlink_kernel_create)(struct net* net, int unit, struct module* module,
                                                        struct netlink_kernel_cfg* cfg);
 static inline struct sock* netlink_kernel_create(struct net* net, int unit, struct netlink_kernel_cfg* cfg) {
@@ -139,4 +166,169 @@ static inline int tracepoint_probe_unregister(struct tracepoint* tp, void* probe
   return -EFAULT;
 }
 
+extern struct task_struct* kfunc_def(kthread_create_on_node)(int (*threadfn)(void* data), void* data, int node,
+                                                             const char namefmt[], ...);
+static inline struct task_struct* kthread_create(int (*threadfn)(void* data), void* data, const char* name) {
+  kfunc_call(kthread_create_on_node, threadfn, data, NUMA_NO_NODE, "%s", name);
+  kfunc_not_found();
+  return NULL;
+}
+
+extern int kfunc_def(kthread_stop)(struct task_struct* k);
+static inline int kthread_stop(struct task_struct* k) {
+  kfunc_call(kthread_stop, k);
+  kfunc_not_found();
+  return -EFAULT;
+}
+
+extern bool kfunc_def(kthread_should_stop)(void);
+static inline bool kthread_should_stop(void) {
+  kfunc_call(kthread_should_stop);
+  kfunc_not_found();
+  return true;
+}
+
+extern void kfunc_def(complete)(struct completion* x);
+static inline void complete(struct completion* x) { kfunc_call_void(complete, x); }
+
+extern long kfunc_def(wait_for_completion_interruptible_timeout)(struct completion* x, unsigned long timeout);
+static inline long wait_for_completion_interruptible_timeout(struct completion* x, unsigned long timeout) {
+  kfunc_call(wait_for_completion_interruptible_timeout, x, timeout);
+  kfunc_not_found();
+  return -EFAULT;
+}
+
+static inline void init_completion(struct completion* x) {
+  x->done = 0;
+  memset(&x->lock, 0, sizeof(x->lock));
+  INIT_LIST_HEAD(&x->task_list);
+}
+static inline void reinit_completion(struct completion* x) { __atomic_store_n(&x->done, 0, __ATOMIC_RELAXED); }
+
+extern unsigned long kfunc_def(__msecs_to_jiffies)(const unsigned int m);
+static inline unsigned long msecs_to_jiffies(const unsigned int m) {
+  kfunc_call(__msecs_to_jiffies, m);
+  kfunc_not_found();
+  return 1;
+}
+
+extern struct task_struct* kfunc_def(find_task_by_vpid)(pid_t nr);
+static inline struct task_struct* find_task_by_vpid(pid_t nr) {
+  kfunc_call(find_task_by_vpid, nr);
+  kfunc_not_found();
+  return NULL;
+}
+
+extern u64 kfunc_def(ktime_get_mono_fast_ns)(void);
+static inline u64 ktime_get_mono_fast_ns(void) {
+  kfunc_call(ktime_get_mono_fast_ns);
+  kfunc_not_found();
+  return 0;
+}
+
+extern ssize_t kfunc_def(simple_read_from_buffer)(void __user* to, size_t count, loff_t* ppos, const void* from,
+                                                  size_t available);
+static inline ssize_t simple_read_from_buffer(void __user* to, size_t count, loff_t* ppos, const void* from,
+                                              size_t available) {
+  kfunc_call(simple_read_from_buffer, to, count, ppos, from, available);
+  kfunc_not_found();
+  return -EFAULT;
+}
+
+extern void* kfunc_def(vmalloc_user)(unsigned long size);
+static inline void* vmalloc_user(unsigned long size) {
+  kfunc_call(vmalloc_user, size);
+  kfunc_not_found();
+  return NULL;
+}
+
+extern int kfunc_def(remap_vmalloc_range)(struct vm_area_struct* vma, void* addr, unsigned long pgoff);
+static inline int remap_vmalloc_range(struct vm_area_struct* vma, void* addr, unsigned long pgoff) {
+  kfunc_call(remap_vmalloc_range, vma, addr, pgoff);
+  kfunc_not_found();
+  return -EFAULT;
+}
+
+extern void kfunc_def(__init_waitqueue_head)(struct wait_queue_head* wq_head, const char* name, void* key);
+static inline void init_waitqueue_head(struct wait_queue_head* wq_head) {
+  kfunc_call_void(__init_waitqueue_head, wq_head, "rekernel", NULL);
+}
+
+extern void kfunc_def(__wake_up)(struct wait_queue_head* wq_head, unsigned int mode, int nr, void* key);
+static inline void wake_up(struct wait_queue_head* wq_head) {
+  kfunc_call_void(__wake_up, wq_head, TASK_NORMAL, 1, NULL);
+}
+static inline void wake_up_interruptible_all(struct wait_queue_head* wq_head) {
+  kfunc_call_void(__wake_up, wq_head, TASK_INTERRUPTIBLE, 0, NULL);
+}
+
+static inline void poll_wait(struct file* filp, struct wait_queue_head* wait_address, struct poll_table_struct* p) {
+  if (p && p->_qproc && wait_address)
+    p->_qproc(filp, wait_address, p);
+}
+
+extern void* kfunc_def(vzalloc)(unsigned long size);
+static inline void* vzalloc(unsigned long size) {
+  kfunc_call(vzalloc, size);
+  kfunc_not_found();
+  return NULL;
+}
+
+extern void kfunc_def(vfree)(const void* addr);
+static inline void vfree(const void* addr) { kfunc_call_void(vfree, addr); }
+
+extern void kfunc_def(mutex_lock)(struct mutex* lock);
+static inline void mutex_lock(struct mutex* lock) { kfunc_call_void(mutex_lock, lock); }
+
+extern void kfunc_def(mutex_unlock)(struct mutex* lock);
+static inline void mutex_unlock(struct mutex* lock) { kfunc_call_void(mutex_unlock, lock); }
+
+extern struct rb_node* kfunc_def(rb_first)(const struct rb_root* root);
+static inline struct rb_node* rb_first(const struct rb_root* root) {
+  kfunc_call(rb_first, root);
+  kfunc_not_found();
+  return NULL;
+}
+
+extern struct rb_node* kfunc_def(rb_next)(const struct rb_node* node);
+static inline struct rb_node* rb_next(const struct rb_node* node) {
+  kfunc_call(rb_next, node);
+  kfunc_not_found();
+  return NULL;
+}
+
+extern void kfunc_def(synchronize_rcu)(void);
+static inline void synchronize_rcu(void) { kfunc_call_void(synchronize_rcu); }
+
+// PREEMPT_RCU 以外的内核没有这两个函数, 关中断或关抢占即为读临界区
+extern void kfunc_def(__rcu_read_lock)(void);
+static inline void rcu_read_lock(void) { kfunc_call_void(__rcu_read_lock); }
+
+extern void kfunc_def(__rcu_read_unlock)(void);
+static inline void rcu_read_unlock(void) { kfunc_call_void(__rcu_read_unlock); }
+
+extern void kfunc_def(msleep)(unsigned int msecs);
+static inline void msleep(unsigned int msecs) { kfunc_call_void(msleep, msecs); }
+
+// arch/arm64/include/asm/irqflags.h
+static inline unsigned long rekernel_irq_save(void) {
+  unsigned long flags;
+  asm volatile("mrs %0, daif\n\tmsr daifset, #3" : "=r"(flags) : : "memory");
+  return flags;
+}
+static inline void rekernel_irq_restore(unsigned long flags) { asm volatile("msr daif, %0" : : "r"(flags) : "memory"); }
+
+// arch/arm64/include/asm/percpu.h
+static inline unsigned long rekernel_cpu_offset(void) {
+  unsigned long off, el;
+  asm volatile("mrs %0, CurrentEL" : "=r"(el));
+  // VHE 内核运行在 EL2
+  if (((el >> 2) & 0x3) == 2) {
+    asm volatile("mrs %0, tpidr_el2" : "=r"(off));
+  } else {
+    asm volatile("mrs %0, tpidr_el1" : "=r"(off));
+  }
+  return off;
+}
+
 #endif /* __RE_UTILS_H */